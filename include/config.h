@@ -1,7 +1,7 @@
 #ifndef CONSTANTS_H
 #define CONSTANTS_H
 
-#define MAX_ROBOT_COUNT 16 //don't change
+#define MAX_ROBOT_COUNT 64 //per team, upper bound of Robots_Count
 #define TEAM_COUNT 2
 
 #endif //CONSTANTS_H
@@ -118,6 +118,14 @@ public:
     double WheelTangentFriction;
     double WheelPerpendicularFriction;
     double Wheel_Motor_FMax;
+    double WheelMaxAcceleration; //rad/s^2, motor setpoint ramp, 0 is off
+    double WheelMotorControlRate; //Hz, firmware motor loop, 0 runs it once per physics step
+    double WheelMotorKp,WheelMotorKi; //PI speed controller (N.m per rad/s, N.m per rad), 0 keeps ODE's velocity motor
+    //reduced model limits
+    double MaxLinearSpeed;
+    double MaxAngularSpeed;
+    double MaxLinearAcceleration;
+    double MaxAngularAcceleration;
 };
 
 
@@ -141,6 +149,8 @@ public:
   /*    Geometry/Game Vartypes   */
   DEF_ENUM(std::string, Division)
   DEF_VALUE(int, Int, Robots_Count)
+  DEF_VALUE(bool,Bool,AutoReferee)
+  DEF_VALUE(double,Double,AutoRefereeDelay)
   DEF_FIELD_VALUE(double,Double,Field_Line_Width)
   DEF_FIELD_VALUE(double,Double,Field_Length)
   DEF_FIELD_VALUE(double,Double,Field_Width)
@@ -162,22 +172,39 @@ public:
   DEF_VALUE(double,Double,BallRadius)
   DEF_VALUE(double,Double,BallMass)
   DEF_VALUE(double,Double,BallFriction)
-  DEF_VALUE(double,Double,BallSlip)
   DEF_VALUE(double,Double,BallBounce)
   DEF_VALUE(double,Double,BallBounceVel)
   DEF_VALUE(double,Double,BallLinearDamp)
   DEF_VALUE(double,Double,BallAngularDamp)
+  DEF_VALUE(bool,Bool,BallCCD)
+  DEF_VALUE(bool,Bool,BallAnalytic)
+  DEF_VALUE(double,Double,BallSlideFriction)
   DEF_VALUE(double,Double,BallDribblingForce)
 
   DEF_VALUE(bool,Bool,SyncWithGL)
   DEF_VALUE(double,Double,DesiredFPS)
   DEF_VALUE(double,Double,DeltaTime)
+  DEF_VALUE(int,Int,MinSubsteps)
+  DEF_VALUE(int,Int,MaxSubsteps)
   DEF_VALUE(int,Int,sendGeometryEvery)
   DEF_VALUE(double,Double,Gravity)
   DEF_VALUE(bool,Bool,ResetTurnOver)
+  DEF_VALUE(double,Double,WatchdogMaxSpeed)
+  DEF_VALUE(double,Double,WatchdogMaxAngSpeed)
+  DEF_VALUE(double,Double,WatchdogEnergyJump)
+  DEF_VALUE(int,Int,PhysicsThreads)
+  DEF_VALUE(bool,Bool,PhysicsThreadsCheck)
+  DEF_VALUE(bool,Bool,AutoDisable)
+  DEF_VALUE(std::string,String,CollisionStatsFile)
+  DEF_ENUM(std::string,BlueRobotModel)
+  DEF_ENUM(std::string,YellowRobotModel)
+  DEF_VALUE(std::string,String,KinematicTrajectoryFile)
   DEF_VALUE(std::string,String,VisionMulticastAddr)  
   DEF_VALUE(int,Int,VisionMulticastPort)  
   DEF_VALUE(int,Int,CommandListenPort)
+  DEF_VALUE(int,Int,BallPredictionPort)
+  DEF_VALUE(std::string,String,GameEventAddr)
+  DEF_VALUE(int,Int,GameEventPort)
   DEF_VALUE(int,Int,BlueStatusSendPort)
   DEF_VALUE(int,Int,YellowStatusSendPort)
   DEF_VALUE(int,Int,sendDelay)
@@ -0,0 +1,68 @@
+/*
+grSim - RoboCup Small Size Soccer Robots Simulator
+Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GAMEEVENTS_H
+#define GAMEEVENTS_H
+
+#include <QVector>
+
+#include "robot.h"
+#include "configwidget.h"
+
+struct GameEvent
+{
+    enum Type
+    {
+        GOAL,     //ball completely over the goal line inside the goal
+        BALL_OUT, //ball completely over a field line anywhere else
+        TOUCH,    //a robot started touching the ball
+        KICK      //a robot kicked the ball
+    };
+    Type type;
+    dReal t;        //simulated time
+    dReal x,y;      //ball position
+    int robot;      //robot index, the last toucher for GOAL and BALL_OUT, -1 if none
+    bool goalYellow;//GOAL: the yellow team scored (ball in the goal on the negative x side)
+    KickStatus kick;//KICK: flat or chip
+    dReal speed;    //ball speed
+};
+
+// Detects game events from the exact simulation state. update() is called for
+// every substep with the ball position before and after it, so lines are
+// crossed in a swept way, and touch() from the ball-robot contact callback.
+class GameEventDetector
+{
+private:
+    ConfigWidget* cfg;
+    QVector<bool> m_touching,m_touched; //per robot, last substep and this one
+    QVector<KickStatus> m_kicking;
+    int m_last_toucher;
+    bool m_out; //ball left the field and has not come back yet
+    QVector<GameEvent> m_events;
+    void add(GameEvent::Type type,dReal t,const dReal* pos,int robot,dReal speed);
+public:
+    GameEventDetector(ConfigWidget* _cfg,int robot_count);
+    void reset();
+    void touch(int robot);
+    void update(dReal t0,dReal t1,const dReal* from,const dReal* to,const dReal* ball_vel,const QVector<Robot*>& robots);
+    int lastToucher() const { return m_last_toucher; }
+    // events detected since the last call
+    QVector<GameEvent> takeEvents();
+};
+
+#endif // GAMEEVENTS_H
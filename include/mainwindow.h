@@ -61,10 +61,12 @@ public slots:
     void customFPS(int fps);
     void showAbout();
     void reconnectCommandSocket();
+    void reconnectPredictionSocket();
     void reconnectYellowStatusSocket();
     void reconnectBlueStatusSocket();
     void reconnectVisionSocket();
     void recvActions();
+    void recvPredictionRequests();
     void setIsGlEnabled(bool value);
 
     int robotIndex(int robot,int team);
@@ -82,11 +84,12 @@ private:
 
     QAction *showsimulator, *showconfig, *showrobot;
     QAction* fullScreenAct;
-    QLabel *fpslabel,*cursorlabel,*selectinglabel,*vanishlabel,*noiselabel;
+    QLabel *fpslabel,*substepslabel,*contactslabel,*cursorlabel,*selectinglabel,*vanishlabel,*noiselabel;
     QString current_dir;
 
     RoboCupSSLServer *visionServer;
     QUdpSocket *commandSocket;
+    QUdpSocket *predictionSocket;
     QUdpSocket *blueStatusSocket,*yellowStatusSocket;
 };
 
@@ -23,6 +23,7 @@
 #define ROBOCUP_SSL_SERVER_H
 #include <string>
 #include <QMutex>
+#include <QByteArray>
 #include <QObject>
 #include "messages_robocup_ssl_detection.pb.h"
 #include "messages_robocup_ssl_geometry.pb.h"
@@ -45,6 +46,7 @@ public:
     ~RoboCupSSLServer();
 
     bool send(const SSL_WrapperPacket & packet);
+    bool send(const SSL_WrapperPacket & packet, const QByteArray & serialized_tail);
     bool send(const SSL_DetectionFrame & frame);
     bool send(const SSL_GeometryData & geometry);
     void change_port(const quint16 &port);
@@ -57,6 +59,7 @@ protected:
     quint16 _port;
     QHostAddress * _net_address;
     QNetworkInterface * _net_interface;
+    QByteArray _buffer;
 };
 
 #endif
@@ -0,0 +1,63 @@
+/*
+grSim - RoboCup Small Size Soccer Robots Simulator
+Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ONBOARDCONTROLLER_H
+#define ONBOARDCONTROLLER_H
+
+#include <ode/ode.h>
+
+struct MotionLimits
+{
+    dReal vx,vy,vw;  //m/s, m/s, rad/s
+    dReal ax,ay,aw;  //m/s^2, m/s^2, rad/s^2
+};
+
+// Velocity that moves a 1D state by d while respecting vmax and amax and
+// arrives with v_end, one dt after a step with current velocity v.
+dReal trapezoidVelocity(dReal d,dReal v,dReal v_end,dReal vmax,dReal amax,dReal dt);
+
+// Pose and chase controllers as run by the robot firmware. Goals are given
+// once and tracked at the physics rate, output is a field frame velocity.
+class OnboardController
+{
+public:
+    enum Mode {IDLE, POSE, CHASE};
+    OnboardController();
+    // target and target_vel are (x,y,w), rotation_sense 1 turns anticlockwise,
+    // -1 clockwise and 0 the shortest way
+    void setPose(const dReal* target,const dReal* target_vel,int rotation_sense,const MotionLimits& limits);
+    // ball and ball_vel are (x,y) at time t, reach is the robot center to
+    // ball center distance when the ball touches the kicker
+    void setChase(const dReal* ball,const dReal* ball_vel,dReal t,dReal reach,const MotionLimits& limits);
+    void stop();
+    Mode mode();
+    // pose and vel are the robot's (x,y,w), cmd gets the velocity (vx,vy,vw)
+    void step(dReal t,dReal dt,const dReal* pose,const dReal* vel,dReal* cmd);
+private:
+    Mode m_mode;
+    bool m_started;
+    dReal m_cmd[3];
+    MotionLimits m_limits;
+    dReal m_target[3],m_target_vel[3];
+    int m_sense;
+    dReal m_ball[2],m_ball_vel[2],m_ball_t,m_reach;
+    bool m_heading_set;
+    void chaseTarget(dReal t,const dReal* pose);
+};
+
+#endif // ONBOARDCONTROLLER_H
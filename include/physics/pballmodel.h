@@ -0,0 +1,44 @@
+/*
+grSim - RoboCup Small Size Soccer Robots Simulator
+Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PBALLMODEL_H
+#define PBALLMODEL_H
+
+#include <ode/ode.h>
+
+// Closed form motion of a solid ball on flat ground. The ball first slides
+// until its contact point comes to rest (Coulomb friction slide_friction),
+// then rolls with a constant deceleration of roll_friction*gravity.
+// Linear and angular velocity also decay at the same damping rate (1/s).
+class PBallModel
+{
+private:
+    dReal m_radius,m_slide,m_roll,m_gravity,m_damping;
+    void slide(dReal* pos,dReal* vel,dReal* angvel,dReal t) const;
+    void roll(dReal* pos,dReal* vel,dReal* angvel,dReal t) const;
+public:
+    PBallModel(dReal radius,dReal slide_friction,dReal roll_friction,dReal gravity,dReal damping=0);
+    // time until the contact point stops slipping
+    dReal slidingTime(const dReal* vel,const dReal* angvel) const;
+    // time until the ball comes to rest
+    dReal stopTime(const dReal* vel,const dReal* angvel) const;
+    // advances pos, vel and angvel by dt, the z components of pos and vel are left untouched
+    void step(dReal* pos,dReal* vel,dReal* angvel,dReal dt) const;
+};
+
+#endif // PBALLMODEL_H
@@ -0,0 +1,84 @@
+/*
+grSim - RoboCup Small Size Soccer Robots Simulator
+Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PBALLPREDICTOR_H
+#define PBALLPREDICTOR_H
+
+#include <ode/ode.h>
+#include <QVector>
+
+#include "pballmodel.h"
+
+struct PBallSample
+{
+    dReal t;
+    dReal pos[3];
+    dReal vel[3];
+};
+
+struct PBallEvent
+{
+    enum Type
+    {
+        HIT,  //touched an obstacle, tag tells which one
+        OUT,  //left the field bounds
+        STOP  //came to rest
+    };
+    Type type;
+    dReal t;
+    dReal pos[3];
+    int tag;
+};
+
+// Ball-only forward simulation. The grounded ball follows PBallModel with
+// the parameters SSLWorld::ballModel gives the simulated ball. The flying
+// ball is integrated with the simulator's substep under gravity and the
+// body's per-step damping, bouncing on the ground with the ball-ground
+// bounce settings. Obstacles are static geoms, the prediction ends at the
+// first one the ball touches.
+// While the ball stays free this reproduces SSLWorld's analytic ball up to
+// rounding. Bounces are a restitution estimate of ODE's contact, and robots
+// that move during the horizon are not accounted for.
+class PBallPredictor
+{
+private:
+    struct Obstacle
+    {
+        dGeomID geom;
+        int tag;
+    };
+    PBallModel m_model;
+    dReal m_radius,m_gravity,m_bounce,m_bounce_vel;
+    dReal m_step,m_damping;
+    dReal m_half_length,m_half_width;
+    QVector<Obstacle> m_obstacles;
+    void fly(dReal* pos,dReal* vel,dReal dt) const;
+public:
+    PBallPredictor(const PBallModel& model,dReal radius,dReal gravity,dReal bounce,dReal bounce_vel);
+    // flight substep and the linear damping applied once per substep
+    void setStep(dReal step,dReal damping);
+    void addObstacle(dGeomID geom,int tag);
+    // the ball is out once it is completely beyond these
+    void setField(dReal half_length,dReal half_width);
+    // samples every sample_dt up to horizon, the last sample is the state at
+    // the end of the prediction (horizon or the first hit/stop event)
+    void predict(const dReal* pos,const dReal* vel,const dReal* angvel,dReal horizon,dReal sample_dt,
+                 QVector<PBallSample>& samples,QVector<PBallEvent>& events) const;
+};
+
+#endif // PBALLPREDICTOR_H
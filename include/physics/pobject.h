@@ -33,11 +33,13 @@ protected:
     dQuaternion q;
     void initPosBody();
     void initPosGeom();
+    void attachToParent();
     bool visible;
 public:
     PObject(dReal x,dReal y,dReal z,dReal red,dReal green,dReal blue,dReal mass);
     virtual ~PObject();
     void setRotation(dReal x_axis,dReal y_axis,dReal z_axis,dReal ang); //Must be called before init()
+    void setParent(PObject* p); //Must be called before init(), the geom is attached to the body of p
     void setBodyPosition(dReal x,dReal y,dReal z,bool local=false);
     void setBodyRotation(dReal x_axis,dReal y_axis,dReal z_axis,dReal ang,bool local=false);
     void getBodyPosition(dReal &x,dReal &y,dReal &z,bool local=false);
@@ -55,6 +57,7 @@ public:
 
     dBodyID body;
     dGeomID geom;
+    PObject* parent;
     dWorldID world;
     dSpaceID space;
     CGraphics *g;
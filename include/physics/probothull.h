@@ -0,0 +1,53 @@
+/*
+grSim - RoboCup Small Size Soccer Robots Simulator
+Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROBOTHULL_H
+#define PROBOTHULL_H
+
+#include "pobject.h"
+
+// Upright robot shape: a cylinder cut flat at the front (local +x).
+// Hull-hull contacts are generated in 2D with a height overlap check, as
+// ODE has no reliable cylinder-cylinder collider.
+// Against a sphere (the ball) the hull also carries the kicker plate in
+// front of the flat and reaches down to the ground, so the ball meets one
+// shape instead of the chassis, wheels and kicker box separately.
+int dRobotHullClass();
+// forgets the class id, dCloseODE drops the registered geom classes
+void dRobotHullCloseClass();
+dGeomID dCreateRobotHull(dSpaceID space,dReal radius,dReal front,dReal height);
+void dGeomRobotHullGetParams(dGeomID g,dReal* radius,dReal* front,dReal* height);
+void dGeomRobotHullSetKicker(dGeomID g,dReal depth,dReal width);
+void dGeomRobotHullGetKicker(dGeomID g,dReal* depth,dReal* width);
+bool dGeomRobotHullOnKicker(dGeomID g,const dReal* pos); //pos lies on the kicker face
+
+class PRobotHull : public PObject
+{
+private:
+    dReal m_radius,m_front,m_height;
+    dReal m_kicker_depth,m_kicker_width;
+public:
+    PRobotHull(dReal x,dReal y,dReal z,dReal radius,dReal front,dReal height,dReal mass);
+    virtual ~PRobotHull();
+    void setKicker(dReal depth,dReal width);
+    virtual void setMass(dReal mass);
+    virtual void init();
+    virtual void draw();
+};
+
+#endif // PROBOTHULL_H
@@ -0,0 +1,76 @@
+/*
+grSim - RoboCup Small Size Soccer Robots Simulator
+Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PSTATS_H
+#define PSTATS_H
+
+#include <QVector>
+#include <QString>
+#include <QFile>
+#include <QTextStream>
+
+// Counters of one collision pass (one substep).
+struct PCollisionCounts
+{
+    int pairs;      //pairs reported by the broadphase
+    int rejected;   //pairs without a surface
+    int collides;   //dCollide calls
+    int contacts;   //contact joints created
+};
+
+// Collision pipeline statistics, per surface type and per substep. The last
+// `history` substeps are kept so histograms can be taken over a rolling window.
+class PCollisionStats
+{
+public:
+    PCollisionStats(int history=600);
+    ~PCollisionStats();
+    int addType(const QString& name);
+    int typeCount();
+    QString typeName(int type);
+    void beginStep();
+    void endStep();
+    void countPair() {current.pairs++;}
+    void countRejected() {current.rejected++;}
+    void countCollide(int type,int contacts);
+    // counts of the last substep, of all types or of one type
+    PCollisionCounts last();
+    PCollisionCounts last(int type);
+    // number of substeps in the window whose contact count of the type
+    // (-1 for all) falls in [i*bin_width,(i+1)*bin_width), the last bin is open
+    QVector<int> contactHistogram(int type,int bin_width,int bin_count);
+    int peakContacts(int type);
+    // one line per substep with totals and per type contacts, empty name stops it
+    bool setCsvFile(const QString& filename);
+private:
+    struct Sample
+    {
+        PCollisionCounts total;
+        QVector<PCollisionCounts> types;
+    };
+    QVector<QString> names;
+    QVector<Sample> samples;
+    int head,filled,steps;
+    PCollisionCounts current;
+    QVector<PCollisionCounts> current_types;
+    QFile* csv;
+    QTextStream csv_stream;
+    void writeCsvHeader();
+};
+
+#endif // PSTATS_H
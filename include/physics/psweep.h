@@ -0,0 +1,37 @@
+/*
+grSim - RoboCup Small Size Soccer Robots Simulator
+Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PSWEEP_H
+#define PSWEEP_H
+
+#include <ode/ode.h>
+
+// Swept sphere tests: a sphere of radius r moving from p to p+d.
+// Each test returns the fraction of d at which the sphere first touches
+// the shape, 0 if it already overlaps it or -1 if it does not touch it on the way.
+
+dReal sweepSphereSphere(const dReal* p,const dReal* d,dReal r,const dReal* center,dReal radius);
+dReal sweepSphereBox(const dReal* p,const dReal* d,dReal r,const dReal* center,const dReal* R,const dReal* sides);
+dReal sweepSphereCylinder(const dReal* p,const dReal* d,dReal r,const dReal* center,const dReal* R,dReal radius,dReal length);
+// upright robot hull (see probothull.h) with its kicker plate, R only gives the heading
+dReal sweepSphereHull(const dReal* p,const dReal* d,dReal r,const dReal* center,const dReal* R,
+                      dReal radius,dReal front,dReal height,dReal kicker_depth,dReal kicker_width);
+// dispatches on the geom class (sphere, box, cylinder and robot hull), d is relative to the geom
+dReal sweepSphereGeom(const dReal* p,const dReal* d,dReal r,dGeomID geom);
+
+#endif // PSWEEP_H
@@ -20,10 +20,29 @@ Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
 #define PWORLD_H
 
 #include "pobject.h"
+#include "pstats.h"
 #include <QMap>
 #include <QVector>
+#include <QString>
 
 class PSurface;
+
+struct PWorldStats
+{
+    int contacts;             //contact joints created in the last step
+    int peak_contacts;        //most contact joints in a single step
+    // working memory held by the ODE stepper. The contact joint group keeps its
+    // own arena inside ODE, which has no query for it, so it is not included;
+    // its size follows peak_contacts
+    size_t step_memory;
+    size_t peak_step_memory;
+    int step_allocations;     //blocks the stepper requested, stays flat once warmed up
+    int step_errors;          //steps that failed or where ODE warned, the world is checked by the caller
+    int substeps;             //world steps in the last frame, a split CCD substep counts twice
+    int determinism_checks;   //threaded steps compared with the serial stepper (setDeterminismCheck)
+    int determinism_mismatches;
+};
+
 class PWorld
 {
 private:
@@ -31,24 +50,66 @@ private:
     QVector<PObject*> objects;
     QVector<PSurface*> surfaces;
     dReal delta_time;
-    int **sur_matrix;
+    QMap<quint64,int> pair_surfaces;  //object id pair -> surface index
+    QMap<quint64,int> group_surfaces; //object group pair -> surface index
+    QVector<int> groups;              //per object id, -1 for none
     int objects_count;
+#ifdef HAVE_ODE_THREADING
+    dThreadingImplementationID threading;
+    dThreadingThreadPoolID thread_pool;
+#endif
+    int thread_count;
+    int peak_contacts;
+    int frame_steps,last_frame_steps;
+    int step_errors;
+    struct BodyState
+    {
+        dBodyID body;
+        dReal pos[3],q[4],lvel[3],avel[3],force[3],torque[3];
+        bool enabled;
+    };
+    bool determinism_check;
+    int determinism_checks,determinism_mismatches;
+    QVector<BodyState> saved_state;
+    void runStep(dReal dt);
+    void saveState();
+    void restoreState();
+    QString last_step_error;
+    void initThreading(int threads);
+    void initStepMemory();
+    int surfaceIndex(dGeomID o1,dGeomID o2);
 public:
-    PWorld(dReal dt,dReal gravity,CGraphics* graphics, int robot_count);
+    PWorld(dReal dt,dReal gravity,CGraphics* graphics, int robot_count, int threads=0);
     ~PWorld();
     void setGravity(dReal gravity);
+    void setAutoDisable(bool enabled);
     void addObject(PObject* o);
     void initAllObjects();
-    PSurface* createSurface(PObject* o1,PObject* o2);
+    PSurface* createSurface(PObject* o1,PObject* o2,const QString& type="other");
     PSurface* findSurface(PObject* o1,PObject* o2);
+    // one surface for every pair of objects from two groups, so crowds of alike
+    // objects (robots against robots) need not list each pair. Objects sharing
+    // a body or joined to each other never collide through it
+    void setGroup(PObject* o,int group);
+    PSurface* createGroupSurface(int group1,int group2,const QString& type="other");
     void step(dReal dt=-1);
+    void endFrame(); //closes the frame counted in stats().substeps
+    // steps every threaded step a second time on the serial stepper from the
+    // same state and counts the steps that do not end bit for bit equal.
+    // Collision callbacks and contact stats run twice per checked step
+    void setDeterminismCheck(bool enabled);
+    quint64 stateHash();
     void glinit();
     void draw();
     void handleCollisions(dGeomID o1, dGeomID o2);    
+    int threadCount();
+    PWorldStats stats();
+    QString lastStepError();
     dWorldID world;
     dSpaceID space;
     CGraphics* g;
     int robot_count;
+    PCollisionStats collisionStats;
 };
 
 typedef bool PSurfaceCallback(dGeomID o1,dGeomID o2,PSurface* s,int robot_count);
@@ -63,5 +124,7 @@ public:
     dVector3 fdir1;  //fdir1 is a normalized vector tangent to friction force vector
     dVector3 contactPos,contactNormal;
     PSurfaceCallback* callback;
+    void* data;      //passed through to the callback
+    int type;        //surface type index in PWorld::collisionStats
 };
 #endif // PWORLD_H
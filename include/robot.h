@@ -23,7 +23,10 @@ Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
 #include "physics/pcylinder.h"
 #include "physics/pbox.h"
 #include "physics/pball.h"
+#include "physics/probothull.h"
 #include "configwidget.h"
+#include "onboardcontroller.h"
+#include <QList>
 
 enum KickStatus
 {
@@ -32,6 +35,19 @@ enum KickStatus
     CHIP_KICK = 2,
 };
 
+enum RobotModel
+{
+    FULL_MODEL = 0,    //chassis, kicker and wheels as separate bodies with wheel-ground friction
+    REDUCED_MODEL = 1, //one body driven by a velocity and acceleration limited holonomic drive
+    KINEMATIC_MODEL = 2, //one kinematic body following a pose trajectory
+};
+
+struct PoseSample
+{
+    dReal t;
+    dReal x,y,dir; //dir in degrees, like replacement packets
+};
+
 class Robot
 {
     PWorld* w;
@@ -42,12 +58,25 @@ class Robot
     int m_rob_id;
     bool firsttime;
     bool last_state;
+    RobotModel m_model;
+    dReal m_wheels_from_body[4][3];
+    dReal m_body_from_wheels[3][4];
+    dReal m_last_delta_dir; //heading PD state of setSpeed with use_dir
+    MotionLimits m_limits; //team settings at construction, the global ones belong to the last team built
+    dReal m_kicker_reach;  //chassis center to the kicker face
+    dReal m_radius;
+    QList<PoseSample> trajectory;
+    void initKinematics();
+    void initReducedDrive();
+    void stepDrive();
 public:    
     ConfigWidget* cfg;
     dSpaceID space;
     PCylinder* chassis;
-    PBall* dummy;
-    dJointID dummy_to_chassis;
+    PRobotHull* hull;
+    dVector3 wheelDirs[4]; //ground friction directions, refreshed every substep
+    OnboardController controller; //CMD_POSE and CMD_CHASE
+    dJointID drive,turn; //reduced model motors
     PBox* boxes[3];    
     bool on;
     //these values are not controled by this class
@@ -59,11 +88,18 @@ public:
       public:
         int id;
         Wheel(Robot* robot,int _id,dReal ang,dReal ang2,int wheeltexid);
-        void step();
+        void step(dReal dt);
         dJointID joint;
         dJointID motor;
         PCylinder* cyl;
-        dReal speed;
+        dReal speed;       //commanded wheel speed
+        dReal motor_speed; //setpoint after the acceleration ramp
+        dReal encoder;     //accumulated wheel angle (rad)
+        dReal max_acceleration,fmax; //team settings at construction
+        dReal kp,ki;             //PI gains, both 0 leaves the speed to ODE's velocity motor
+        dReal control_period;    //firmware loop period, 0 runs once per physics step
+        dReal control_clock;     //time since the last loop tick
+        dReal integral,torque;   //PI state and the torque held until the next tick
         Robot* rob;
     } *wheels[4];
     class Kicker
@@ -73,6 +109,8 @@ public:
         int rolling;
         int kickstate;
         dReal m_kickspeed,m_kicktime;
+        bool touchingBall; //infrared sensor, see updateBallProximity
+        dReal ball_along;  //ball distance from the kicker face along the robot direction
       public:
         Kicker(Robot* robot);
         void step();
@@ -80,6 +118,7 @@ public:
         void setRoller(int roller);
         int getRoller();
         void toggleRoller();
+        void updateBallProximity(const dReal* ball_pos);
         bool isTouchingBall();
         KickStatus isKicking();
         void holdBall();
@@ -91,12 +130,16 @@ public:
         bool holdingBall;
     } *kicker;
 
-    Robot(PWorld* world,PBall* ball,ConfigWidget* _cfg,dReal x,dReal y,dReal z,dReal r,dReal g,dReal b,int rob_id,int wheeltexid,int dir);
+    Robot(PWorld* world,PBall* ball,ConfigWidget* _cfg,dReal x,dReal y,dReal z,dReal r,dReal g,dReal b,int rob_id,int wheeltexid,int dir,RobotModel model=FULL_MODEL);
     ~Robot();
     void step();
+    void updateOnState();
+    void wake();
+    void updateWheelDirs();
     void drawLabel();
     void setSpeed(int i,dReal s); //i = 0,1,2,3
-    void setSpeed(dReal vx, dReal vy, dReal vw, bool use_dir, int id);
+    void setSpeed(dReal vx, dReal vy, dReal vw, bool use_dir);
+    void stepMotors(dReal dt);
     dReal getSpeed(int i);
     void incSpeed(int i,dReal v);
     void resetSpeeds();
@@ -107,6 +150,13 @@ public:
     void setXY(dReal x,dReal y);
     void setDir(dReal ang);
     int getID();
+    RobotModel getModel();
+    void addPoseSample(dReal t,dReal x,dReal y,dReal dir);
+    void followTrajectory(dReal t,dReal dt);
+    MotionLimits motionLimits();
+    dReal kickerReach();
+    dReal radius();
+    void stepOnboard(dReal t,dReal dt);
     PBall* getBall();
     PWorld* getWorld();
 };
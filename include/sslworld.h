@@ -24,6 +24,7 @@ Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
 #include <QObject>
 #include <QUdpSocket>
 #include <QList>
+#include <QVector>
 
 
 #include "graphics.h"
@@ -32,10 +33,13 @@ Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
 #include "physics/pground.h"
 #include "physics/pfixedbox.h"
 #include "physics/pray.h"
+#include "physics/pballpredictor.h"
 
 #include "net/robocup_ssl_server.h"
 
 #include "robot.h"
+#include "gameevents.h"
+#include "watchdog.h"
 #include "configwidget.h"
 
 #include "config.h"
@@ -47,9 +51,22 @@ Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
 class RobotsFomation;
 class SendingPacket {
     public:
-    SendingPacket(SSL_WrapperPacket* _packet,int _t);
-    SSL_WrapperPacket* packet;
+    SSL_WrapperPacket packet; //reused, cleared by generatePacket
     int t;
+    bool geometry; //the cached geometry is appended when sending
+};
+
+// state read by the vision output, taken once at the end of a step
+struct VisionSnapshot
+{
+    struct RobotState
+    {
+        bool on;
+        dReal x,y,dir; //dir in degrees
+    };
+    int frame;
+    dReal ball[3];
+    QVector<RobotState> robots; //blue robots first, then yellow
 };
 
 class SSLWorld : public QObject
@@ -59,11 +76,21 @@ private:
     QGLWidget* m_parent;
     int framenum;
     dReal last_dt;
-    QList<SendingPacket*> sendQueue;
+    QVector<SendingPacket*> sendRing; //delayed vision packets, a ring of reused slots
+    int sendHead,sendCount;
+    QByteArray geometryCache; //serialized wrapper packet with the field geometry
+    SendingPacket* queueVisionPacket(int t);
     char packet[200];
     char *in_buffer;
-    bool lastInfraredState[TEAM_COUNT][MAX_ROBOT_COUNT];
-    KickStatus lastKickState[TEAM_COUNT][MAX_ROBOT_COUNT]; 
+    QVector<bool> lastInfraredState[TEAM_COUNT];
+    QVector<KickStatus> lastKickState[TEAM_COUNT];
+    RobotsFomation* forms[TEAM_COUNT]; //kickoff formations
+    dReal refereeRestart; //simulated time of the pending auto referee restart, -1 if none
+    bool refereeKickoff;
+    dReal refereeBall[2];
+    WorldWatchdog* watchdog;
+    int stepErrors; //PWorld step errors already reported
+    int determinismMismatches; //and threaded steps that differed from serial ones
     inline const static int _CAM_NUM = 4; 
     inline const static double _CAM_CX[_CAM_NUM] = {1,1,-1,-1};
     inline const static double _CAM_CY[_CAM_NUM] = {1,-1,-1,1};  
@@ -74,9 +101,25 @@ public:
     virtual ~SSLWorld();
     void glinit();
     void step(dReal dt=-1);
-    SSL_WrapperPacket* generatePacket(int cam_id=0);
+    int substepCount(dReal dt);
+    // fraction of h before the ball hits something, 0 while it already touches an
+    // obstacle and -1 for none. travel receives the distance the ball covers
+    // relative to the obstacle it hits
+    dReal ballTimeOfImpact(dReal h,dReal* travel = nullptr);
+    bool ballIsFree(dReal dt);
+    // the grounded ball model matching the ODE ball for substeps of length h
+    PBallModel ballModel(dReal h);
+    void updateBallProximity();
+    MotionLimits commandLimits(int id,const ZSS::New::CmdPose& pose);
+    void loadTrajectories(const QString& filename);
+    // predicts the ball from pos/vel (the simulated ball if null), robots are static obstacles
+    void predictBall(dReal horizon,dReal sample_dt,QVector<PBallSample>& samples,QVector<PBallEvent>& events,
+                     const dReal* pos=nullptr,const dReal* vel=nullptr);
+    void takeVisionSnapshot();
+    // fills the frames of all cameras, packets holds _CAM_NUM packets
+    void generatePackets(const VisionSnapshot& snap,SSL_WrapperPacket** packets);
+    const QByteArray& geometryDatagram();
     void addFieldLinesArcs(SSL_GeometryFieldSize *field);
-    Vector2f* allocVector(float x, float y);
     void addFieldLine(SSL_GeometryFieldSize *field, const std::string &name, float p1_x, float p1_y, float p2_x, float p2_y, float thickness);
     void addFieldArc(SSL_GeometryFieldSize *field, const string &name, float c_x, float c_y, float radius, float a1, float a2, float thickness);
     void sendVisionBuffer();
@@ -86,6 +129,10 @@ public:
     int  robotIndex(int robot,int team);
     void addRobotStatus(ZSS::New::Robots_Status& robotsPacket, int robotID, int team, bool infrared, KickStatus kickStatus);
     void sendRobotStatus(ZSS::New::Robots_Status& robotsPacket, QHostAddress sender, int team);
+    void publishGameEvents(const QVector<GameEvent>& events);
+    void stepReferee(const QVector<GameEvent>& events);
+    void placeBall(dReal x,dReal y,dReal vx,dReal vy);
+    void checkHealth();
 
     ConfigWidget* cfg;
     CGraphics* g;
@@ -100,30 +147,42 @@ public:
     dReal cursor_radius;
     RoboCupSSLServer *visionServer;
     QUdpSocket *commandSocket;
+    QUdpSocket *predictionSocket;
     QUdpSocket *blueStatusSocket,*yellowStatusSocket;
+    QUdpSocket *eventSocket;
+    GameEventDetector* gameEvents;
     bool updatedCursor;
-    Robot* robots[MAX_ROBOT_COUNT*2];
+    QVector<Robot*> robots; //blue robots first, then yellow
     QTime *timer;
     int sendGeomCount;
+    int substeps; //substeps used in the last frame
+    bool ballAnalytic; //ball is moved by PBallModel in this frame
+    dReal simTime; //simulated seconds since the world was created
+    VisionSnapshot visionSnapshot;
+    dSurfaceParameters ballRobotSurface,ballKickerSurface;
+    dSurfaceParameters ballGroundSurface; //free ball, the dribbler overrides it while it holds the ball
 public slots:
     void recvActions();
+    void recvPredictionRequests();
 signals:
     void fpsChanged(int newFPS);
+    void gameEvent(const GameEvent& event);
 };
 
 class RobotsFomation {
     public:
-        dReal x[MAX_ROBOT_COUNT];
-        dReal y[MAX_ROBOT_COUNT];
+        QVector<dReal> x;
+        QVector<dReal> y;
         RobotsFomation(int type, ConfigWidget* _cfg);
-        void setAll(dReal *xx,dReal *yy);
+        void setAll(const dReal *xx,const dReal *yy,int n);
         void loadFromFile(const QString& filename);
-        void resetRobots(Robot** r,int team);
+        void resetRobots(const QVector<Robot*>& r,int team);
     private:
         ConfigWidget* cfg;
 };
 
 dReal fric(dReal f);
 int robotIndex(int robot,int team);
+RobotModel robotModel(const std::string& name);
 
 #endif // SSLWORLD_H
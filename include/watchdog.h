@@ -0,0 +1,67 @@
+/*
+grSim - RoboCup Small Size Soccer Robots Simulator
+Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <QVector>
+
+#include "robot.h"
+#include "physics/pball.h"
+#include "configwidget.h"
+
+struct WatchdogFault
+{
+    enum Type
+    {
+        NOT_FINITE, //NaN or Inf in a position, rotation or velocity
+        LOST,       //left the world (fell through the ground)
+        VELOCITY,   //faster than the configured limits
+        ENERGY,     //kinetic energy jump of one robot or the ball
+        FLIPPED     //robot turning over, only with ResetTurnOver
+    };
+    Type type;
+    int object;     //robot index, -1 for the ball
+    dReal value;    //the offending speed, energy or up component
+    dReal x,y;      //last healthy position, where the object is put back
+};
+
+// Health check of the simulated bodies, run once per frame after the
+// substeps. Healthy frames only read a few values per body; faulty ones are
+// reported with the last healthy position so the caller can reset them.
+class WorldWatchdog
+{
+private:
+    ConfigWidget* cfg;
+    QVector<dReal> m_good_x,m_good_y; //per robot, last healthy position
+    dReal m_ball_x,m_ball_y;
+    dReal m_ball_energy;
+    QVector<dReal> m_robot_energy; //per robot, kinetic energy in the last frame
+    QVector<WatchdogFault> m_faults;
+    int m_recoveries;
+    void add(WatchdogFault::Type type,int object,dReal value);
+    bool checkRobot(int k,Robot* robot);
+    bool checkEnergy(int object,dReal energy,dReal& last);
+public:
+    WorldWatchdog(ConfigWidget* _cfg,int robot_count);
+    // returns the faults found in this frame, one per object at most
+    const QVector<WatchdogFault>& check(PBall* ball,const QVector<Robot*>& robots);
+    int recoveries() const { return m_recoveries; }
+};
+
+#endif // WATCHDOG_H
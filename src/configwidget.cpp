@@ -45,6 +45,8 @@ ConfigWidget::ConfigWidget()
   ADD_TO_ENUM(Division, "Division B");
   END_ENUM(game_vars, Division);
   ADD_VALUE(game_vars,Int, Robots_Count, 8, "Robots Count")
+  ADD_VALUE(game_vars,Bool,AutoReferee,false,"Auto referee (place the ball, kickoff after goals)")
+  ADD_VALUE(game_vars,Double,AutoRefereeDelay,1.0,"Auto referee restart delay (simulated seconds)")
   VarListPtr fields_vars(new VarList("Field"));
   VarListPtr div_a_vars(new VarList("Division A"));
   VarListPtr div_b_vars(new VarList("Division B"));
@@ -99,23 +101,50 @@ ConfigWidget::ConfigWidget()
         ADD_VALUE(worldp_vars,Double,DesiredFPS,65,"Desired FPS")
         ADD_VALUE(worldp_vars,Bool,SyncWithGL,false,"Synchronize ODE with OpenGL")
         ADD_VALUE(worldp_vars,Double,DeltaTime,0.016,"ODE time step")
+        ADD_VALUE(worldp_vars,Int,MinSubsteps,4,"Minimum substeps per step")
+        ADD_VALUE(worldp_vars,Int,MaxSubsteps,8,"Maximum substeps per step")
         ADD_VALUE(worldp_vars,Double,Gravity,9.8,"Gravity")
         ADD_VALUE(worldp_vars,Bool,ResetTurnOver,true,"Auto reset turn-over")
+        ADD_VALUE(worldp_vars,Double,WatchdogMaxSpeed,20,"Watchdog speed limit (m/s)")
+        ADD_VALUE(worldp_vars,Double,WatchdogMaxAngSpeed,100,"Watchdog robot angular speed limit (rad/s)")
+        ADD_VALUE(worldp_vars,Double,WatchdogEnergyJump,50,"Watchdog kinetic energy jump (J)")
+        ADD_VALUE(worldp_vars,Int,PhysicsThreads,0,"Island stepping threads (0 = off)")
+        ADD_VALUE(worldp_vars,Bool,PhysicsThreadsCheck,false,"Compare threaded steps with serial ones")
+        ADD_VALUE(worldp_vars,Bool,AutoDisable,true,"Disable resting bodies")
+        ADD_VALUE(worldp_vars,String,CollisionStatsFile,"","Collision statistics file (csv, empty = off)")
+    VarListPtr robotp_vars(new VarList("Robots"));
+    phys_vars->addChild(robotp_vars);
+        ADD_ENUM(StringEnum,BlueRobotModel,"Full","Blue robot model")
+        ADD_TO_ENUM(BlueRobotModel,"Full")
+        ADD_TO_ENUM(BlueRobotModel,"Reduced")
+        ADD_TO_ENUM(BlueRobotModel,"Kinematic")
+        END_ENUM(robotp_vars,BlueRobotModel)
+        ADD_ENUM(StringEnum,YellowRobotModel,"Full","Yellow robot model")
+        ADD_TO_ENUM(YellowRobotModel,"Full")
+        ADD_TO_ENUM(YellowRobotModel,"Reduced")
+        ADD_TO_ENUM(YellowRobotModel,"Kinematic")
+        END_ENUM(robotp_vars,YellowRobotModel)
+        ADD_VALUE(robotp_vars,String,KinematicTrajectoryFile,"","Kinematic robots trajectory file (csv)")
   VarListPtr ballp_vars(new VarList("Ball"));
     phys_vars->addChild(ballp_vars);
         ADD_VALUE(ballp_vars,Double,BallMass,0.043,"Ball mass");
         ADD_VALUE(ballp_vars,Double,BallFriction,0.05,"Ball-ground friction")
-        ADD_VALUE(ballp_vars,Double,BallSlip,1,"Ball-ground slip")
         ADD_VALUE(ballp_vars,Double,BallBounce,0.5,"Ball-ground bounce factor")
         ADD_VALUE(ballp_vars,Double,BallBounceVel,0.1,"Ball-ground bounce min velocity")
         ADD_VALUE(ballp_vars,Double,BallLinearDamp,0.004,"Ball linear damping")
         ADD_VALUE(ballp_vars,Double,BallAngularDamp,0.004,"Ball angular damping")
+        ADD_VALUE(ballp_vars,Bool,BallCCD,true,"Ball continuous collision detection")
+        ADD_VALUE(ballp_vars,Bool,BallAnalytic,true,"Analytic model for the grounded ball")
+        ADD_VALUE(ballp_vars,Double,BallSlideFriction,0.35,"Ball-ground sliding friction")
         ADD_VALUE(ballp_vars,Double,BallDribblingForce,0.067,"Ball dribbling force")
   VarListPtr comm_vars(new VarList("Communication"));
   world.push_back(comm_vars);
     ADD_VALUE(comm_vars,String,VisionMulticastAddr,"224.5.23.2","Vision multicast address")  //SSL Vision: "224.5.23.2"
     ADD_VALUE(comm_vars,Int,VisionMulticastPort,10020,"Vision multicast port(auto x & x+1)")
     ADD_VALUE(comm_vars,Int,CommandListenPort,20011,"Command listen port")
+    ADD_VALUE(comm_vars,Int,BallPredictionPort,20012,"Ball prediction listen port")
+    ADD_VALUE(comm_vars,String,GameEventAddr,"127.0.0.1","Game event send address")
+    ADD_VALUE(comm_vars,Int,GameEventPort,10030,"Game event send port (0 to disable)")
     ADD_VALUE(comm_vars,Int,BlueStatusSendPort,30011,"Blue Team status send port")
     ADD_VALUE(comm_vars,Int,YellowStatusSendPort,30012,"Yellow Team status send port")
     ADD_VALUE(comm_vars,Int,sendDelay,0,"Sending delay (milliseconds)")
@@ -255,4 +284,12 @@ void ConfigWidget::loadRobotSettings(QString team)
     robotSettings.WheelTangentFriction = robot_settings->value("Physics/WheelTangentFriction", 0.8f).toDouble();
     robotSettings.WheelPerpendicularFriction = robot_settings->value("Physics/WheelPerpendicularFriction", 0.05f).toDouble();
     robotSettings.Wheel_Motor_FMax = robot_settings->value("Physics/WheelMotorMaximumApplyingTorque", 0.2f).toDouble();
+    robotSettings.WheelMaxAcceleration = robot_settings->value("Physics/WheelMaxAcceleration", 0).toDouble();
+    robotSettings.WheelMotorControlRate = robot_settings->value("Physics/WheelMotorControlRate", 0).toDouble();
+    robotSettings.WheelMotorKp = robot_settings->value("Physics/WheelMotorKp", 0).toDouble();
+    robotSettings.WheelMotorKi = robot_settings->value("Physics/WheelMotorKi", 0).toDouble();
+    robotSettings.MaxLinearSpeed = robot_settings->value("Physics/MaxLinearSpeed", 3.5f).toDouble();
+    robotSettings.MaxAngularSpeed = robot_settings->value("Physics/MaxAngularSpeed", 10.0f).toDouble();
+    robotSettings.MaxLinearAcceleration = robot_settings->value("Physics/MaxLinearAcceleration", 4.0f).toDouble();
+    robotSettings.MaxAngularAcceleration = robot_settings->value("Physics/MaxAngularAcceleration", 40.0f).toDouble();
 }
@@ -0,0 +1,114 @@
+/*
+grSim - RoboCup Small Size Soccer Robots Simulator
+Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gameevents.h"
+#include <cmath>
+#include <algorithm>
+
+GameEventDetector::GameEventDetector(ConfigWidget* _cfg,int robot_count)
+{
+    cfg = _cfg;
+    m_touching.resize(robot_count);
+    m_touched.resize(robot_count);
+    m_kicking.resize(robot_count);
+    reset();
+}
+
+void GameEventDetector::reset()
+{
+    m_touching.fill(false);
+    m_touched.fill(false);
+    m_kicking.fill(NO_KICK);
+    m_last_toucher = -1;
+    m_out = false;
+    m_events.clear();
+}
+
+void GameEventDetector::touch(int robot)
+{
+    if (robot >= 0 && robot < m_touched.size()) m_touched[robot] = true;
+}
+
+void GameEventDetector::add(GameEvent::Type type,dReal t,const dReal* pos,int robot,dReal speed)
+{
+    GameEvent e;
+    e.type = type;
+    e.t = t;
+    e.x = pos[0];
+    e.y = pos[1];
+    e.robot = robot;
+    e.goalYellow = pos[0] < 0;
+    e.kick = NO_KICK;
+    e.speed = speed;
+    m_events.append(e);
+}
+
+void GameEventDetector::update(dReal t0,dReal t1,const dReal* from,const dReal* to,const dReal* ball_vel,const QVector<Robot*>& robots)
+{
+    const dReal speed = sqrt(ball_vel[0]*ball_vel[0] + ball_vel[1]*ball_vel[1] + ball_vel[2]*ball_vel[2]);
+    for (int k=0;k<m_touched.size();k++)
+    {
+        if (m_touched[k] && !m_touching[k])
+        {
+            m_last_toucher = k;
+            add(GameEvent::TOUCH,t0,from,k,speed);
+        }
+        m_touching[k] = m_touched[k];
+        m_touched[k] = false;
+        const KickStatus kicking = robots[k]->kicker->isKicking();
+        if (kicking != NO_KICK && m_kicking[k] == NO_KICK)
+        {
+            m_last_toucher = k;
+            add(GameEvent::KICK,t0,from,k,speed);
+            m_events.last().kick = kicking;
+        }
+        m_kicking[k] = kicking;
+    }
+
+    const dReal r = cfg->BallRadius();
+    const dReal lx = cfg->Field_Length()/2 + r,ly = cfg->Field_Width()/2 + r;
+    if (fabs(to[0]) < lx - 2*r && fabs(to[1]) < ly - 2*r)
+    {
+        m_out = false;
+        return;
+    }
+    if (m_out) return;
+    // first time along the substep at which the ball is completely out
+    dReal f = 2;
+    const dReal d[2] = {to[0]-from[0],to[1]-from[1]};
+    for (int i=0;i<2;i++)
+    {
+        const dReal l = (i==0) ? lx : ly;
+        if (fabs(to[i]) <= l) continue;
+        if (fabs(from[i]) > l) f = 0;
+        else f = std::min(f,(std::copysign(l,to[i]) - from[i])/d[i]);
+    }
+    if (f > 1) return;
+    m_out = true;
+    const dReal pos[3] = {from[0]+f*d[0],from[1]+f*d[1],from[2]+f*(to[2]-from[2])};
+    const dReal t = t0 + f*(t1-t0);
+    const bool in_goal = fabs(pos[0]) >= lx - 1e-9 && fabs(pos[1]) < cfg->Goal_Width()/2 && pos[2] < cfg->Goal_Height();
+    add(in_goal ? GameEvent::GOAL : GameEvent::BALL_OUT,t,pos,m_last_toucher,speed);
+}
+
+QVector<GameEvent> GameEventDetector::takeEvents()
+{
+    QVector<GameEvent> events;
+    events.swap(m_events);
+    return events;
+}
@@ -204,6 +204,7 @@ void GLWidget::mousePressEvent(QMouseEvent *event)
             ssl->ball->setBodyPosition(ssl->cursor_x,ssl->cursor_y,cfg->BallRadius()*1.1*20.0);
             dBodySetAngularVel(ssl->ball->body,0,0,0);
             dBodySetLinearVel(ssl->ball->body,0,0,0);
+            dBodyEnable(ssl->ball->body);
             ssl->show3DCursor = false;
             state = CursorMode::STEADY;
         }
@@ -225,6 +226,7 @@ void GLWidget::mousePressEvent(QMouseEvent *event)
                 y *= kickpower;
                 dBodySetLinearVel(ssl->ball->body,x,y,0);
                 dBodySetAngularVel(ssl->ball->body,-y/cfg->BallRadius(),x/cfg->BallRadius(),0);
+                dBodyEnable(ssl->ball->body);
             }
             else if (chiping) {
                 dReal x,y,z;
@@ -240,6 +242,7 @@ void GLWidget::mousePressEvent(QMouseEvent *event)
 
                 dBodySetLinearVel(ssl->ball->body,x,y,z);
                 dBodySetAngularVel(ssl->ball->body,-y/cfg->BallRadius(),x/cfg->BallRadius(),z);    
+                dBodyEnable(ssl->ball->body);
             }
         
         }
@@ -423,6 +426,7 @@ void GLWidget::putBall(dReal x,dReal y)
     ssl->ball->setBodyPosition(x,y,0.3);
     dBodySetLinearVel(ssl->ball->body,0,0,0);
     dBodySetAngularVel(ssl->ball->body,0,0,0);
+    dBodyEnable(ssl->ball->body);
 }
 
 void GLWidget::keyReleaseEvent(QKeyEvent* event)
@@ -453,14 +457,14 @@ void GLWidget::keyPressEvent(QKeyEvent *event)
     case 'g': case 'G': ssl->robots[R]->incSpeed(0,S);ssl->robots[R]->incSpeed(1,-S);ssl->robots[R]->incSpeed(2,S);ssl->robots[R]->incSpeed(3,-S);break;
     case 'f': case 'F': ssl->robots[R]->incSpeed(0,S);ssl->robots[R]->incSpeed(1,S);ssl->robots[R]->incSpeed(2,S);ssl->robots[R]->incSpeed(3,S);break;
     case 'h': case 'H': ssl->robots[R]->incSpeed(0,-S);ssl->robots[R]->incSpeed(1,-S);ssl->robots[R]->incSpeed(2,-S);ssl->robots[R]->incSpeed(3,-S);break;
-    case 'w': case 'W':dBodyAddForce(ssl->ball->body,0, BallForce,0);break;
-    case 's': case 'S':dBodyAddForce(ssl->ball->body,0,-BallForce,0);break;
-    case 'd': case 'D':dBodyAddForce(ssl->ball->body, BallForce,0,0);break;
-    case 'a': case 'A':dBodyAddForce(ssl->ball->body,-BallForce,0,0);break;
+    case 'w': case 'W':dBodyEnable(ssl->ball->body);dBodyAddForce(ssl->ball->body,0, BallForce,0);break;
+    case 's': case 'S':dBodyEnable(ssl->ball->body);dBodyAddForce(ssl->ball->body,0,-BallForce,0);break;
+    case 'd': case 'D':dBodyEnable(ssl->ball->body);dBodyAddForce(ssl->ball->body, BallForce,0,0);break;
+    case 'a': case 'A':dBodyEnable(ssl->ball->body);dBodyAddForce(ssl->ball->body,-BallForce,0,0);break;
     case 'k': case 'K': ssl->robots[R]->kicker->kick(8,0);break;
     case 'l': case 'L': ssl->robots[R]->kicker->kick(3,3);break;
     case 'j': case 'J': ssl->robots[R]->kicker->toggleRoller();break;
-    case 'i': case 'I': dBodySetLinearVel(ssl->ball->body,2.0,0,0);dBodySetAngularVel(ssl->ball->body,0,2.0/cfg->BallRadius(),0);break;
+    case 'i': case 'I': dBodySetLinearVel(ssl->ball->body,2.0,0,0);dBodySetAngularVel(ssl->ball->body,0,2.0/cfg->BallRadius(),0);dBodyEnable(ssl->ball->body);break;
     case ';':
         if (!kickingball)
             logStatus(QString("Kick mode On"),QColor("blue"));
@@ -541,6 +545,7 @@ void GLWidget::moveBallHere()
     ssl->ball->setBodyPosition(ssl->cursor_x,ssl->cursor_y,cfg->BallRadius()*2);
     dBodySetLinearVel(ssl->ball->body, 0.0, 0.0, 0.0);
     dBodySetAngularVel(ssl->ball->body, 0.0, 0.0, 0.0);
+    dBodyEnable(ssl->ball->body);
 
 }
 
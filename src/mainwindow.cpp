@@ -75,15 +75,18 @@ MainWindow::MainWindow(QWidget *parent)
 
     visionServer = NULL;
     commandSocket = NULL;
+    predictionSocket = NULL;
     blueStatusSocket = NULL;
     yellowStatusSocket = NULL;
     reconnectVisionSocket();
     reconnectCommandSocket();
+    reconnectPredictionSocket();
     reconnectBlueStatusSocket();
     reconnectYellowStatusSocket();
 
     glwidget->ssl->visionServer = visionServer;
     glwidget->ssl->commandSocket = commandSocket;
+    glwidget->ssl->predictionSocket = predictionSocket;
     glwidget->ssl->blueStatusSocket = blueStatusSocket;
     glwidget->ssl->yellowStatusSocket = yellowStatusSocket;
 
@@ -93,16 +96,22 @@ MainWindow::MainWindow(QWidget *parent)
     robotwidget->setObjectName("RobotWidget");
     /* Status Bar */
     fpslabel = new QLabel(this);
+    substepslabel = new QLabel(this);
+    contactslabel = new QLabel(this);
     cursorlabel = new QLabel(this);
     selectinglabel = new QLabel(this);
     vanishlabel = new QLabel("Vanishing",this);
     noiselabel = new QLabel("Gaussian noise",this);
     fpslabel->setFrameStyle(QFrame::Panel);
+    substepslabel->setFrameStyle(QFrame::Panel);
+    contactslabel->setFrameStyle(QFrame::Panel);
     cursorlabel->setFrameStyle(QFrame::Panel);
     selectinglabel->setFrameStyle(QFrame::Panel);
     vanishlabel->setFrameStyle(QFrame::Panel);
     noiselabel->setFrameStyle(QFrame::Panel);
     statusBar()->addWidget(fpslabel);
+    statusBar()->addWidget(substepslabel);
+    statusBar()->addWidget(contactslabel);
     statusBar()->addWidget(cursorlabel);
     statusBar()->addWidget(selectinglabel);
     statusBar()->addWidget(vanishlabel);
@@ -195,13 +204,19 @@ MainWindow::MainWindow(QWidget *parent)
     QObject::connect(configwidget->v_BallRadius.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(restartSimulator()));
     QObject::connect(configwidget->v_BallMass.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(changeBallMass()));
     QObject::connect(configwidget->v_BallDribblingForce.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(changeBallDribblingForce()));
-    QObject::connect(configwidget->v_BallFriction.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(changeBallGroundSurface()));
-    QObject::connect(configwidget->v_BallSlip.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(changeBallGroundSurface()));
+    QObject::connect(configwidget->v_BallSlideFriction.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(changeBallGroundSurface()));
     QObject::connect(configwidget->v_BallBounce.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(changeBallGroundSurface()));
     QObject::connect(configwidget->v_BallBounceVel.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(changeBallGroundSurface()));
     QObject::connect(configwidget->v_BallLinearDamp.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(changeBallDamping()));
     QObject::connect(configwidget->v_BallAngularDamp.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(changeBallDamping()));
     QObject::connect(configwidget->v_Gravity.get(),  SIGNAL(wasEdited(VarPtr)), this, SLOT(changeGravity()));
+    QObject::connect(configwidget->v_PhysicsThreads.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(restartSimulator()));
+    QObject::connect(configwidget->v_PhysicsThreadsCheck.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(restartSimulator()));
+    QObject::connect(configwidget->v_AutoDisable.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(restartSimulator()));
+    QObject::connect(configwidget->v_CollisionStatsFile.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(restartSimulator()));
+    QObject::connect(configwidget->v_BlueRobotModel.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(restartSimulator()));
+    QObject::connect(configwidget->v_YellowRobotModel.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(restartSimulator()));
+    QObject::connect(configwidget->v_KinematicTrajectoryFile.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(restartSimulator()));
 
     //geometry config vars
     QObject::connect(configwidget->v_DesiredFPS.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(changeTimer()));
@@ -247,6 +262,7 @@ MainWindow::MainWindow(QWidget *parent)
     QObject::connect(configwidget->v_VisionMulticastAddr.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(reconnectVisionSocket()));
     QObject::connect(configwidget->v_VisionMulticastPort.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(reconnectVisionSocket()));
     QObject::connect(configwidget->v_CommandListenPort.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(reconnectCommandSocket()));
+    QObject::connect(configwidget->v_BallPredictionPort.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(reconnectPredictionSocket()));
     QObject::connect(configwidget->v_BlueStatusSendPort.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(reconnectBlueStatusSocket()));
     QObject::connect(configwidget->v_YellowStatusSendPort.get(), SIGNAL(wasEdited(VarPtr)), this, SLOT(reconnectYellowStatusSocket()));
     timer->start();
@@ -359,6 +375,11 @@ void MainWindow::update()
     
     QString ss;
     fpslabel->setText(QString("Frame rate: %1 fps").arg(ss.sprintf("%06.2f",glwidget->getFPS())));        
+    PWorldStats pstats = glwidget->ssl->p->stats();
+    substepslabel->setText(QString("Substeps: %1").arg(pstats.substeps));
+    contactslabel->setText(QString("Contacts: %1 (peak %2), stepper memory: %3 KB (%4 allocs)")
+                           .arg(pstats.contacts).arg(pstats.peak_contacts)
+                           .arg(pstats.peak_step_memory/1024).arg(pstats.step_allocations));
     if (glwidget->ssl->selected!=-1)
     {
         selectinglabel->setVisible(true);
@@ -403,13 +424,12 @@ void MainWindow::changeBallDribblingForce()
 
 void MainWindow::changeBallGroundSurface()
 {
-    PSurface* ballwithwall = glwidget->ssl->p->findSurface(glwidget->ssl->ball,glwidget->ssl->ground);
-    ballwithwall->surface.mode = dContactBounce | dContactApprox1 | dContactSlip1 | dContactSlip2;
-    ballwithwall->surface.mu = fric(configwidget->BallFriction());
-    ballwithwall->surface.bounce = configwidget->BallBounce();
-    ballwithwall->surface.bounce_vel = configwidget->BallBounceVel();
-    ballwithwall->surface.slip1 = configwidget->BallSlip();
-    ballwithwall->surface.slip2 = configwidget->BallSlip();
+    //same as the surface built by SSLWorld, the grounded ball model assumes Coulomb friction
+    dSurfaceParameters& ballwithground = glwidget->ssl->ballGroundSurface;
+    ballwithground.mode = dContactBounce | dContactApprox1;
+    ballwithground.mu = configwidget->BallSlideFriction();
+    ballwithground.bounce = configwidget->BallBounce();
+    ballwithground.bounce_vel = configwidget->BallBounceVel();
 }
 
 void MainWindow::changeBallDamping()
@@ -427,6 +447,7 @@ void MainWindow::restartSimulator()
     glwidget->ssl->glinit();
     glwidget->ssl->visionServer = visionServer;
     glwidget->ssl->commandSocket = commandSocket;
+    glwidget->ssl->predictionSocket = predictionSocket;
     glwidget->ssl->blueStatusSocket = blueStatusSocket;
     glwidget->ssl->yellowStatusSocket = yellowStatusSocket;
 
@@ -540,6 +561,20 @@ void MainWindow::reconnectCommandSocket()
     QObject::connect(commandSocket,SIGNAL(readyRead()),this,SLOT(recvActions()));
 }
 
+void MainWindow::reconnectPredictionSocket()
+{
+    if (predictionSocket!=NULL)
+    {
+        QObject::disconnect(predictionSocket,SIGNAL(readyRead()),this,SLOT(recvPredictionRequests()));
+        delete predictionSocket;
+    }
+    predictionSocket = new QUdpSocket(this);
+    if (predictionSocket->bind(QHostAddress::Any,configwidget->BallPredictionPort()))
+        logStatus(QString("Ball prediction port binded on: %1").arg(configwidget->BallPredictionPort()),QColor("green"));
+    QObject::connect(predictionSocket,SIGNAL(readyRead()),this,SLOT(recvPredictionRequests()));
+    glwidget->ssl->predictionSocket = predictionSocket;
+}
+
 void MainWindow::reconnectVisionSocket()
 {
     if (visionServer == NULL) {
@@ -555,6 +590,11 @@ void MainWindow::recvActions()
     glwidget->ssl->recvActions();
 }
 
+void MainWindow::recvPredictionRequests()
+{
+    glwidget->ssl->recvPredictionRequests();
+}
+
 void MainWindow::setIsGlEnabled(bool value)
 {
   glwidget->ssl->isGLEnabled = value;
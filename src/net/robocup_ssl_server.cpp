@@ -22,6 +22,7 @@
 #include "robocup_ssl_server.h"
 #include <QtNetwork>
 #include <iostream>
+#include <cstring>
 #include "logger.h"
 
 using namespace std;
@@ -63,15 +64,24 @@ void RoboCupSSLServer::change_interface(const string & net_interface)
 
 bool RoboCupSSLServer::send(const SSL_WrapperPacket & packet)
 {
-    QByteArray datagram;
+    return send(packet, QByteArray());
+}
+
+bool RoboCupSSLServer::send(const SSL_WrapperPacket & packet, const QByteArray & serialized_tail)
+{
+    // the buffer keeps its capacity, so steady traffic does not allocate
+    QByteArray& datagram = _buffer;
 
-    datagram.resize(packet.ByteSize());
-    bool success = packet.SerializeToArray(datagram.data(), datagram.size());
+    const int size = packet.ByteSize();
+    datagram.resize(size + serialized_tail.size());
+    bool success = packet.SerializeToArray(datagram.data(), size);
     if(!success) {
         //TODO: print useful info
         logStatus(QString("Serializing packet to array failed."), QColor("red"));
         return false;
     }
+    // concatenated messages parse as one merged message
+    memcpy(datagram.data() + size, serialized_tail.constData(), serialized_tail.size());
 
     mutex.lock();
     quint64 bytes_sent = _socket->writeDatagram(datagram, *_net_address, _port);
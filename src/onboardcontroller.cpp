@@ -0,0 +1,158 @@
+/*
+grSim - RoboCup Small Size Soccer Robots Simulator
+Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "onboardcontroller.h"
+#include <cmath>
+#include <algorithm>
+
+namespace {
+    dReal normalizeAngle(dReal a)
+    {
+        while (a > M_PI) a -= 2*M_PI;
+        while (a <= -M_PI) a += 2*M_PI;
+        return a;
+    }
+
+    dReal clamp(dReal x,dReal lo,dReal hi)
+    {
+        return std::max(lo,std::min(x,hi));
+    }
+}
+
+dReal trapezoidVelocity(dReal d,dReal v,dReal v_end,dReal vmax,dReal amax,dReal dt)
+{
+    if (vmax <= 0 || amax <= 0) return 0;
+    // fastest speed from which v_end is still reached within d
+    dReal desired;
+    if (fabs(d) < 1e-6) desired = v_end;
+    else
+    {
+        const dReal s = (d > 0) ? 1 : -1;
+        const dReal v_arrive = std::max(s*v_end,(dReal)0);
+        desired = s*std::min(vmax,sqrt(v_arrive*v_arrive + 2*amax*fabs(d)));
+        if (fabs(desired) > fabs(d)/dt + v_arrive) desired = s*(fabs(d)/dt + v_arrive); //do not overshoot within one step
+    }
+    desired = clamp(desired,-vmax,vmax);
+    return v + clamp(desired - v,-amax*dt,amax*dt);
+}
+
+OnboardController::OnboardController()
+{
+    m_mode = IDLE;
+    m_started = false;
+    m_sense = 0;
+    for (int i=0;i<3;i++) m_cmd[i] = 0;
+    m_ball_t = m_reach = 0;
+    m_heading_set = false;
+    for (int i=0;i<3;i++) m_target[i] = m_target_vel[i] = 0;
+    m_ball[0] = m_ball[1] = m_ball_vel[0] = m_ball_vel[1] = 0;
+    m_limits.vx = m_limits.vy = m_limits.vw = 0;
+    m_limits.ax = m_limits.ay = m_limits.aw = 0;
+}
+
+void OnboardController::setPose(const dReal* target,const dReal* target_vel,int rotation_sense,const MotionLimits& limits)
+{
+    if (m_mode == IDLE) m_started = false;
+    m_mode = POSE;
+    m_limits = limits;
+    m_sense = rotation_sense;
+    for (int i=0;i<3;i++)
+    {
+        m_target[i] = target[i];
+        m_target_vel[i] = target_vel[i];
+    }
+}
+
+void OnboardController::setChase(const dReal* ball,const dReal* ball_vel,dReal t,dReal reach,const MotionLimits& limits)
+{
+    if (m_mode == IDLE) m_started = false;
+    m_mode = CHASE;
+    m_limits = limits;
+    m_sense = 0;
+    m_ball[0] = ball[0];
+    m_ball[1] = ball[1];
+    m_ball_vel[0] = ball_vel[0];
+    m_ball_vel[1] = ball_vel[1];
+    m_ball_t = t;
+    m_reach = reach;
+    m_heading_set = false;
+}
+
+void OnboardController::stop()
+{
+    m_mode = IDLE;
+}
+
+OnboardController::Mode OnboardController::mode()
+{
+    return m_mode;
+}
+
+void OnboardController::chaseTarget(dReal t,const dReal* pose)
+{
+    // earliest time the robot can be at the kicking pose behind the
+    // extrapolated ball, searched in 20 ms steps over the next three seconds
+    const dReal vmax = std::max(std::min(m_limits.vx,m_limits.vy),(dReal)0.1);
+    const dReal offset = m_heading_set ? m_reach : 0;
+    // a robot already riding along with the ball has to match lead 0
+    const dReal slack = hypot(m_ball_vel[0],m_ball_vel[1])*0.02 + 0.01;
+    dReal bx = m_ball[0],by = m_ball[1];
+    for (dReal lead=0;lead<3;lead+=0.02)
+    {
+        const dReal age = t - m_ball_t + lead;
+        bx = m_ball[0] + m_ball_vel[0]*age;
+        by = m_ball[1] + m_ball_vel[1]*age;
+        if (hypot(bx - offset*cos(m_target[2]) - pose[0],by - offset*sin(m_target[2]) - pose[1]) <= vmax*lead + slack) break;
+    }
+    // the approach heading is fixed when the chase starts, steering it
+    // towards the ball on every step makes the robot circle around it
+    if (!m_heading_set)
+    {
+        m_target[2] = (hypot(bx - pose[0],by - pose[1]) > m_reach) ? atan2(by - pose[1],bx - pose[0]) : pose[2];
+        m_heading_set = true;
+    }
+    m_target[0] = bx - m_reach*cos(m_target[2]);
+    m_target[1] = by - m_reach*sin(m_target[2]);
+    m_target_vel[0] = m_target_vel[1] = m_target_vel[2] = 0;
+}
+
+void OnboardController::step(dReal t,dReal dt,const dReal* pose,const dReal* vel,dReal* cmd)
+{
+    cmd[0] = cmd[1] = cmd[2] = 0;
+    if (m_mode == IDLE || dt <= 0) return;
+    if (m_mode == CHASE) chaseTarget(t,pose);
+    // the ramp continues from the last command, the measured velocity only seeds it
+    if (!m_started) for (int i=0;i<3;i++) m_cmd[i] = vel[i];
+    m_started = true;
+    // a chased target moves with the ball, the ramp is planned relative to it
+    const dReal drift[2] = {m_mode == CHASE ? m_ball_vel[0] : 0,m_mode == CHASE ? m_ball_vel[1] : 0};
+    cmd[0] = drift[0] + trapezoidVelocity(m_target[0] - pose[0],m_cmd[0] - drift[0],m_target_vel[0],m_limits.vx,m_limits.ax,dt);
+    cmd[1] = drift[1] + trapezoidVelocity(m_target[1] - pose[1],m_cmd[1] - drift[1],m_target_vel[1],m_limits.vy,m_limits.ay,dt);
+    cmd[0] = clamp(cmd[0],-m_limits.vx,m_limits.vx);
+    cmd[1] = clamp(cmd[1],-m_limits.vy,m_limits.vy);
+    dReal dw = normalizeAngle(m_target[2] - pose[2]);
+    if (fabs(dw) > 0.1) //close to the target the shortest way is always taken
+    {
+        if (m_sense > 0 && dw < 0) dw += 2*M_PI;
+        if (m_sense < 0 && dw > 0) dw -= 2*M_PI;
+    }
+    cmd[2] = trapezoidVelocity(dw,m_cmd[2],m_target_vel[2],m_limits.vw,m_limits.aw,dt);
+    m_cmd[0] = cmd[0];
+    m_cmd[1] = cmd[1];
+    m_cmd[2] = cmd[2];
+}
@@ -30,11 +30,15 @@ PBall::~PBall()
 
 void PBall::init()
 {
-    body = dBodyCreate (world);
-    initPosBody();
-    setMass(m_mass);
     geom = dCreateSphere (0,m_radius);
-    dGeomSetBody (geom,body);
+    if (parent!=NULL) attachToParent();
+    else
+    {
+        body = dBodyCreate (world);
+        initPosBody();
+        setMass(m_mass);
+        dGeomSetBody (geom,body);
+    }
     dSpaceAdd(space,geom);
 }
 
@@ -55,5 +59,5 @@ void PBall::setMass(dReal mass)
 void PBall::draw()
 {
   PObject::draw();
-  g->drawSphere(dBodyGetPosition(body),dBodyGetRotation(body),m_radius);
+  g->drawSphere(dGeomGetPosition(geom),dGeomGetRotation(geom),m_radius);
 }
@@ -0,0 +1,129 @@
+/*
+grSim - RoboCup Small Size Soccer Robots Simulator
+Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pballmodel.h"
+#include <cmath>
+#include <algorithm>
+
+PBallModel::PBallModel(dReal radius,dReal slide_friction,dReal roll_friction,dReal gravity,dReal damping)
+{
+    m_radius = radius;
+    m_slide = slide_friction;
+    m_roll = roll_friction;
+    m_gravity = gravity;
+    m_damping = damping;
+}
+
+// velocity of the contact point relative to the ground: v + w x (0,0,-r)
+static inline void contactVelocity(const dReal* vel,const dReal* angvel,dReal r,dReal* u)
+{
+    u[0] = vel[0] - r*angvel[1];
+    u[1] = vel[1] + r*angvel[0];
+}
+
+// decay factor exp(-k t), its integral g1 over [0,t] and the integral g2 of g1
+static void decay(dReal k,dReal t,dReal& E,dReal& g1,dReal& g2)
+{
+    const dReal kt = k*t;
+    if (kt < 1e-4)
+    {
+        E = 1 - kt;
+        g1 = t*(1 - 0.5*kt);
+        g2 = t*t*(0.5 - kt/6);
+        return;
+    }
+    E = exp(-kt);
+    g1 = (1 - E)/k;
+    g2 = (t - g1)/k;
+}
+
+// time for a speed s to reach zero under v' = -a - k v
+static dReal timeToRest(dReal s,dReal a,dReal k)
+{
+    if (a <= 0) return dInfinity;
+    return (k > 0) ? log1p(k*s/a)/k : s/a;
+}
+
+dReal PBallModel::slidingTime(const dReal* vel,const dReal* angvel) const
+{
+    if (m_slide <= 0) return 0;
+    dReal u[2];
+    contactVelocity(vel,angvel,m_radius,u);
+    // friction slows the contact point down with 7/2 mu g for a solid sphere
+    return timeToRest(sqrt(u[0]*u[0] + u[1]*u[1]),3.5*m_slide*m_gravity,m_damping);
+}
+
+dReal PBallModel::stopTime(const dReal* vel,const dReal* angvel) const
+{
+    const dReal ts = slidingTime(vel,angvel);
+    dReal v[3] = {vel[0],vel[1],0},w[3] = {angvel[0],angvel[1],angvel[2]},pos[3] = {0,0,0};
+    slide(pos,v,w,ts);
+    return ts + timeToRest(sqrt(v[0]*v[0] + v[1]*v[1]),m_roll*m_gravity,m_damping);
+}
+
+void PBallModel::slide(dReal* pos,dReal* vel,dReal* angvel,dReal t) const
+{
+    if (t <= 0) return;
+    dReal u[2];
+    contactVelocity(vel,angvel,m_radius,u);
+    const dReal un = sqrt(u[0]*u[0] + u[1]*u[1]);
+    if (un < 1e-9) return;
+    // the friction direction is constant during the whole sliding phase,
+    // damping shrinks the contact velocity without turning it
+    const dReal a = m_slide*m_gravity;
+    const dReal dx = -a*u[0]/un,dy = -a*u[1]/un;
+    dReal E,g1,g2;
+    decay(m_damping,t,E,g1,g2);
+    pos[0] += vel[0]*g1 + dx*g2;
+    pos[1] += vel[1]*g1 + dy*g2;
+    vel[0] = vel[0]*E + dx*g1;
+    vel[1] = vel[1]*E + dy*g1;
+    // torque of the friction force, I = 2/5 m r^2
+    angvel[0] = angvel[0]*E + 2.5*dy*g1/m_radius;
+    angvel[1] = angvel[1]*E - 2.5*dx*g1/m_radius;
+    angvel[2] *= E;
+}
+
+void PBallModel::roll(dReal* pos,dReal* vel,dReal* angvel,dReal t) const
+{
+    dReal speed = sqrt(vel[0]*vel[0] + vel[1]*vel[1]);
+    if (t > 0 && speed > 0)
+    {
+        const dReal a = m_roll*m_gravity;
+        const dReal tau = std::min(t,timeToRest(speed,a,m_damping));
+        const dReal nx = vel[0]/speed,ny = vel[1]/speed;
+        dReal E,g1,g2;
+        decay(m_damping,tau,E,g1,g2);
+        const dReal dist = speed*g1 - a*g2;
+        pos[0] += nx*dist;
+        pos[1] += ny*dist;
+        speed = std::max(speed*E - a*g1,(dReal)0);
+        vel[0] = nx*speed;
+        vel[1] = ny*speed;
+    }
+    angvel[0] = -vel[1]/m_radius;
+    angvel[1] =  vel[0]/m_radius;
+    if (t > 0) angvel[2] *= exp(-m_damping*t);
+}
+
+void PBallModel::step(dReal* pos,dReal* vel,dReal* angvel,dReal dt) const
+{
+    const dReal ts = std::min(slidingTime(vel,angvel),dt);
+    slide(pos,vel,angvel,ts);
+    if (dt > ts) roll(pos,vel,angvel,dt-ts);
+}
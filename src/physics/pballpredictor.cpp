@@ -0,0 +1,133 @@
+/*
+grSim - RoboCup Small Size Soccer Robots Simulator
+Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pballpredictor.h"
+#include "psweep.h"
+#include <cmath>
+#include <algorithm>
+
+PBallPredictor::PBallPredictor(const PBallModel& model,dReal radius,dReal gravity,dReal bounce,dReal bounce_vel)
+    : m_model(model)
+{
+    m_radius = radius;
+    m_gravity = gravity;
+    m_bounce = bounce;
+    m_bounce_vel = bounce_vel;
+    m_step = 0.004;
+    m_damping = 0;
+    m_half_length = m_half_width = dInfinity;
+}
+
+void PBallPredictor::setStep(dReal step,dReal damping)
+{
+    m_step = step;
+    m_damping = damping;
+}
+
+void PBallPredictor::addObstacle(dGeomID geom,int tag)
+{
+    m_obstacles.append({geom,tag});
+}
+
+void PBallPredictor::setField(dReal half_length,dReal half_width)
+{
+    m_half_length = half_length;
+    m_half_width = half_width;
+}
+
+void PBallPredictor::fly(dReal* pos,dReal* vel,dReal dt) const
+{
+    // the order of an ODE step: forces, damping, then the position update
+    for (dReal t=0;t<dt;t+=m_step)
+    {
+        const dReal step = std::min(m_step,dt-t);
+        vel[2] -= m_gravity*step;
+        const dReal scale = pow(1 - m_damping,step/m_step);
+        for (int i=0;i<3;i++) vel[i] *= scale;
+        for (int i=0;i<3;i++) pos[i] += vel[i]*step;
+        if (pos[2] < m_radius && vel[2] < 0)
+        {
+            pos[2] = m_radius;
+            vel[2] = (-vel[2] > m_bounce_vel) ? -m_bounce*vel[2] : 0;
+        }
+    }
+}
+
+void PBallPredictor::predict(const dReal* pos,const dReal* vel,const dReal* angvel,dReal horizon,dReal sample_dt,
+                             QVector<PBallSample>& samples,QVector<PBallEvent>& events) const
+{
+    samples.clear();
+    events.clear();
+    if (sample_dt <= 0) return;
+    PBallSample s = {0,{pos[0],pos[1],pos[2]},{vel[0],vel[1],vel[2]}};
+    dReal w[3] = {angvel[0],angvel[1],angvel[2]};
+    samples.append(s);
+    bool out = false;
+    while (s.t < horizon)
+    {
+        const dReal dt = std::min(sample_dt,horizon - s.t);
+        PBallSample next = s;
+        next.t += dt;
+        // same test as SSLWorld::ballIsFree
+        if (s.pos[2] > m_radius*1.1 || fabs(s.vel[2]) > 0.05)
+            fly(next.pos,next.vel,dt);
+        else
+        {
+            next.pos[2] = m_radius;
+            next.vel[2] = 0;
+            m_model.step(next.pos,next.vel,w,dt);
+        }
+        const dReal d[3] = {next.pos[0]-s.pos[0],next.pos[1]-s.pos[1],next.pos[2]-s.pos[2]};
+        dReal best = -1;
+        int tag = 0;
+        for (const Obstacle& o : m_obstacles)
+        {
+            const dReal f = sweepSphereGeom(s.pos,d,m_radius,o.geom);
+            if (f >= 0 && (best < 0 || f < best))
+            {
+                best = f;
+                tag = o.tag;
+            }
+        }
+        if (best >= 0)
+        {
+            PBallEvent e = {PBallEvent::HIT,s.t + best*dt,{s.pos[0]+best*d[0],s.pos[1]+best*d[1],s.pos[2]+best*d[2]},tag};
+            next.t = e.t;
+            for (int i=0;i<3;i++)
+            {
+                next.pos[i] = e.pos[i];
+                next.vel[i] = s.vel[i] + best*(next.vel[i]-s.vel[i]);
+            }
+            samples.append(next);
+            events.append(e);
+            return;
+        }
+        if (!out && (fabs(next.pos[0]) > m_half_length + m_radius || fabs(next.pos[1]) > m_half_width + m_radius))
+        {
+            out = true;
+            events.append({PBallEvent::OUT,next.t,{next.pos[0],next.pos[1],next.pos[2]},0});
+        }
+        samples.append(next);
+        s = next;
+        if (s.pos[2] <= m_radius && s.vel[2] == 0 && s.vel[0]*s.vel[0] + s.vel[1]*s.vel[1] < 1e-6)
+        {
+            events.append({PBallEvent::STOP,s.t,{s.pos[0],s.pos[1],s.pos[2]},0});
+            return;
+        }
+    }
+}
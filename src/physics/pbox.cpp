@@ -33,11 +33,15 @@ PBox::~PBox()
 
 void PBox::init()
 {
-  body = dBodyCreate (world);
-  initPosBody();
-  setMass(m_mass);
   geom = dCreateBox (0,m_w,m_h,m_l);
-  dGeomSetBody (geom,body);
+  if (parent!=NULL) attachToParent();
+  else
+  {
+    body = dBodyCreate (world);
+    initPosBody();
+    setMass(m_mass);
+    dGeomSetBody (geom,body);
+  }
   dSpaceAdd (space,geom);
 }
 
@@ -42,9 +42,6 @@ void PCylinder::setMass(dReal mass)
 
 void PCylinder::init()
 {
-  body = dBodyCreate (world);
-  initPosBody();
-  setMass(m_mass);
 /*  if (m_texid!=-1)
   {
       dTriMeshDataID g = dGeomTriMeshDataCreate();
@@ -131,7 +128,14 @@ void PCylinder::init()
   {
     geom = dCreateCylinder(0,m_radius,m_length);
   }
-  dGeomSetBody (geom,body);
+  if (parent!=NULL) attachToParent();
+  else
+  {
+    body = dBodyCreate (world);
+    initPosBody();
+    setMass(m_mass);
+    dGeomSetBody (geom,body);
+  }
   dSpaceAdd (space,geom);
 }
 
@@ -139,14 +143,14 @@ void PCylinder::draw()
 {
     PObject::draw();    
     if (m_texid==-1)
-        g->drawCylinder(dBodyGetPosition(body),dBodyGetRotation(body),m_length,m_radius);
+        g->drawCylinder(dGeomGetPosition(geom),dGeomGetRotation(geom),m_length,m_radius);
     else
-        g->drawCylinder_TopTextured(dBodyGetPosition(body),dBodyGetRotation(body),m_length,m_radius,m_texid,m_robot);
+        g->drawCylinder_TopTextured(dGeomGetPosition(geom),dGeomGetRotation(geom),m_length,m_radius,m_texid,m_robot);
 
 /*    glColor3f(1.0, 1.0, 1.0);
     glPushMatrix();
 
-        g->setTransform(dBodyGetPosition(body),dBodyGetRotation(body));
+        g->setTransform(dGeomGetPosition(geom),dGeomGetRotation(geom));
            glScaled(m_radius, m_radius, m_radius);
            glColor3d(0.1, 0.1, 0.1);
            glRasterPos3f(-0.25, 1.5, 0.0);
@@ -22,6 +22,7 @@ PObject::PObject(dReal x,dReal y,dReal z,dReal red,dReal green,dReal blue,dReal
 {
     geom = NULL;
     body = NULL;
+    parent = NULL;
     world = NULL;
     space = NULL;
     m_x = x;
@@ -64,7 +65,7 @@ void PObject::getColor(dReal& r,dReal& g,dReal& b)
 PObject::~PObject()
 {
     if (geom!=NULL) dGeomDestroy(geom);
-    if (body!=NULL) dBodyDestroy(body);
+    if (body!=NULL && parent==NULL) dBodyDestroy(body);
 }
 
 void PObject::setRotation(dReal x_axis,dReal y_axis,dReal z_axis,dReal ang)
@@ -73,6 +74,11 @@ void PObject::setRotation(dReal x_axis,dReal y_axis,dReal z_axis,dReal ang)
     isQSet = true;
 }
 
+void PObject::setParent(PObject* p)
+{
+    parent = p;
+}
+
 void PObject::setBodyPosition(dReal x,dReal y,dReal z,bool local)
 {
     if (!local) dBodySetPosition(body,x,y,z);
@@ -99,7 +105,7 @@ void PObject::getBodyPosition(dReal &x,dReal &y,dReal &z,bool local)
         z = local_Pos[2];
         return;
     }
-    const dReal *r=dBodyGetPosition(body);
+    const dReal *r=(parent!=NULL) ? dGeomGetPosition(geom) : dBodyGetPosition(body);
     x = r[0];
     y = r[1];
     z = r[2];
@@ -135,7 +141,7 @@ void PObject::getBodyRotation(dMatrix3 r,bool local)
         for (int k=0;k<12;k++) r[k] = local_Rot[k];
     }
     else {
-        const dReal* rr = dBodyGetRotation(body);
+        const dReal* rr = (parent!=NULL) ? dGeomGetRotation(geom) : dBodyGetRotation(body);
         for (int k=0;k<12;k++) r[k] = rr[k];
     }
 }
@@ -146,6 +152,14 @@ void PObject::initPosBody()
     if (isQSet) dBodySetQuaternion(body,q);
 }
 
+void PObject::attachToParent()
+{
+    body = parent->body;
+    dGeomSetBody(geom,body);
+    dGeomSetOffsetWorldPosition(geom,m_x,m_y,m_z);
+    if (isQSet) dGeomSetOffsetWorldQuaternion(geom,q);
+}
+
 void PObject::initPosGeom()
 {
     dGeomSetPosition(geom,m_x,m_y,m_z);
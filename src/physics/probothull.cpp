@@ -0,0 +1,460 @@
+/*
+grSim - RoboCup Small Size Soccer Robots Simulator
+Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "probothull.h"
+#include <cmath>
+#include <algorithm>
+
+namespace {
+    struct HullData
+    {
+        dReal radius,front,height;
+        dReal kicker_depth,kicker_width; //plate in front of the flat, ball contacts only
+    };
+
+    // hull footprint in world coordinates
+    struct Hull2D
+    {
+        dReal c[2],f[2],t[2];
+        dReal radius,front,half_chord;
+    };
+
+    int hull_class = -1;
+
+    void footprint(dGeomID g,Hull2D& h)
+    {
+        const HullData* data = (const HullData*)dGeomGetClassData(g);
+        const dReal* pos = dGeomGetPosition(g);
+        const dReal* R = dGeomGetRotation(g);
+        h.c[0] = pos[0];
+        h.c[1] = pos[1];
+        const dReal len = sqrt(R[0]*R[0] + R[4]*R[4]);
+        h.f[0] = R[0]/len;
+        h.f[1] = R[4]/len;
+        h.t[0] = -h.f[1];
+        h.t[1] =  h.f[0];
+        h.radius = data->radius;
+        h.front = data->front;
+        h.half_chord = sqrt(std::max(data->radius*data->radius - data->front*data->front,(dReal)0));
+    }
+
+    inline dReal dot2(const dReal* a,const dReal* b) {return a[0]*b[0] + a[1]*b[1];}
+
+    void corner(const Hull2D& h,int side,dReal* p)
+    {
+        const dReal s = side ? h.half_chord : -h.half_chord;
+        p[0] = h.c[0] + h.front*h.f[0] + s*h.t[0];
+        p[1] = h.c[1] + h.front*h.f[1] + s*h.t[1];
+    }
+
+    // farthest point of the hull along n
+    void support(const Hull2D& h,const dReal* n,dReal* p)
+    {
+        if (h.radius*dot2(n,h.f) <= h.front)
+        {
+            p[0] = h.c[0] + h.radius*n[0];
+            p[1] = h.c[1] + h.radius*n[1];
+            return;
+        }
+        dReal p0[2],p1[2];
+        corner(h,0,p0);
+        corner(h,1,p1);
+        const dReal* best = (dot2(p0,n) > dot2(p1,n)) ? p0 : p1;
+        p[0] = best[0];
+        p[1] = best[1];
+    }
+
+    dReal extent(const Hull2D& h,const dReal* n)
+    {
+        dReal p[2];
+        support(h,n,p);
+        return dot2(p,n);
+    }
+
+    int collideHullHull(dGeomID o1,dGeomID o2,int flags,dContactGeom* contact,int skip)
+    {
+        const HullData* d1 = (const HullData*)dGeomGetClassData(o1);
+        const HullData* d2 = (const HullData*)dGeomGetClassData(o2);
+        const dReal z1 = dGeomGetPosition(o1)[2],z2 = dGeomGetPosition(o2)[2];
+        const dReal zlo = std::max(z1 - d1->height*0.5,z2 - d2->height*0.5);
+        const dReal zhi = std::min(z1 + d1->height*0.5,z2 + d2->height*0.5);
+        if (zlo >= zhi) return 0;
+
+        Hull2D A,B;
+        footprint(o1,A);
+        footprint(o2,B);
+
+        // separating axis test over the axes that can separate two such shapes:
+        // center line, front normals and corner-to-center/corner-to-corner lines
+        dReal axes[11][2];
+        int count = 0;
+        auto addAxis = [&](dReal x,dReal y) {axes[count][0] = x;axes[count][1] = y;count++;};
+        addAxis(B.c[0]-A.c[0],B.c[1]-A.c[1]);
+        addAxis(A.f[0],A.f[1]);
+        addAxis(B.f[0],B.f[1]);
+        dReal ca[2][2],cb[2][2];
+        for (int i=0;i<2;i++) {corner(A,i,ca[i]);corner(B,i,cb[i]);}
+        for (int i=0;i<2;i++)
+        {
+            addAxis(B.c[0]-ca[i][0],B.c[1]-ca[i][1]);
+            addAxis(cb[i][0]-A.c[0],cb[i][1]-A.c[1]);
+            for (int j=0;j<2;j++) addAxis(cb[j][0]-ca[i][0],cb[j][1]-ca[i][1]);
+        }
+        dReal n[2] = {0,0},depth = dInfinity;
+        for (int i=0;i<count;i++)
+        {
+            dReal len = sqrt(dot2(axes[i],axes[i]));
+            if (len < 1e-9) continue;
+            dReal a[2] = {axes[i][0]/len,axes[i][1]/len};
+            dReal na[2] = {-a[0],-a[1]};
+            const dReal ab = extent(A,a) + extent(B,na);  //A's max against B's min
+            const dReal ba = extent(B,a) + extent(A,na);
+            const dReal overlap = std::min(ab,ba);
+            if (overlap <= 0) return 0;
+            if (overlap < depth)
+            {
+                depth = overlap;
+                const dReal s = (ab <= ba) ? 1 : -1;  //n points from A to B
+                n[0] = s*a[0];
+                n[1] = s*a[1];
+            }
+        }
+        if (depth == dInfinity) return 0;
+
+        dReal pa[2],pb[2],nb[2] = {-n[0],-n[1]};
+        support(A,n,pa);
+        support(B,nb,pb);
+        dReal m[2] = {(pa[0]+pb[0])*0.5,(pa[1]+pb[1])*0.5};
+        // a flat front touches with its whole face, the other shape tells where
+        const bool flat1 = dot2(A.f,n) > 0.999,flat2 = dot2(B.f,nb) > 0.999;
+        if (flat1 && !flat2) {m[0] = pb[0];m[1] = pb[1];}
+        if (flat2 && !flat1) {m[0] = pa[0];m[1] = pa[1];}
+        dReal points[2][2] = {{m[0],m[1]},{m[0],m[1]}};
+        int num = 1;
+        // two flat fronts pressed together get a contact at each end of their overlap
+        const int max_contacts = flags & 0xffff;
+        if (max_contacts >= 2 && flat1 && flat2)
+        {
+            const dReal t[2] = {-n[1],n[0]};
+            dReal alo = dot2(ca[0],t),ahi = dot2(ca[1],t);
+            dReal blo = dot2(cb[0],t),bhi = dot2(cb[1],t);
+            if (alo > ahi) std::swap(alo,ahi);
+            if (blo > bhi) std::swap(blo,bhi);
+            const dReal lo = std::max(alo,blo),hi = std::min(ahi,bhi);
+            if (hi > lo)
+            {
+                const dReal mt = dot2(m,t);
+                for (int i=0;i<2;i++)
+                {
+                    const dReal s = (i ? hi : lo) - mt;
+                    points[i][0] = m[0] + s*t[0];
+                    points[i][1] = m[1] + s*t[1];
+                }
+                num = 2;
+            }
+        }
+        for (int i=0;i<num;i++)
+        {
+            dContactGeom* c = (dContactGeom*)((char*)contact + i*skip);
+            c->pos[0] = points[i][0];
+            c->pos[1] = points[i][1];
+            c->pos[2] = (zlo + zhi)*0.5;
+            // ODE normals point from the second geom into the first
+            c->normal[0] = -n[0];
+            c->normal[1] = -n[1];
+            c->normal[2] = 0;
+            c->depth = depth;
+            c->g1 = o1;
+            c->g2 = o2;
+        }
+        return num;
+    }
+
+    // body of the hull in its local frame: the circle cut at x = front
+    // returns false if p is inside, otherwise the nearest boundary point
+    bool nearestOnBody(const HullData* d,const dReal* p,dReal* q)
+    {
+        const dReal chord = sqrt(std::max(d->radius*d->radius - d->front*d->front,(dReal)0));
+        const dReal len = sqrt(dot2(p,p));
+        if (p[0] <= d->front && len <= d->radius) return false;
+        dReal best = dInfinity;
+        if (len > 1e-9 && p[0]*d->radius <= d->front*len)  //nearest on the arc
+        {
+            q[0] = p[0]*d->radius/len;
+            q[1] = p[1]*d->radius/len;
+            best = len - d->radius;
+        }
+        const dReal f[2] = {d->front,std::max(-chord,std::min(p[1],chord))};
+        const dReal df[2] = {p[0]-f[0],p[1]-f[1]};
+        if (dot2(df,df) < best*best)
+        {
+            q[0] = f[0];
+            q[1] = f[1];
+        }
+        return true;
+    }
+
+    bool nearestOnKicker(const HullData* d,const dReal* p,dReal* q)
+    {
+        q[0] = std::max(d->front,std::min(p[0],d->front + d->kicker_depth));
+        q[1] = std::max(-d->kicker_width*0.5,std::min(p[1],d->kicker_width*0.5));
+        return q[0] != p[0] || q[1] != p[1];
+    }
+
+    struct LocalContact
+    {
+        dReal pos[3],normal[3],depth;  //normal points out of the hull
+    };
+
+    // the ball can only be above or beside the hull, the robot stands on the
+    // ground so the bottom face is never hit
+    int collideHullSphere(dGeomID o1,dGeomID o2,int flags,dContactGeom* contact,int skip)
+    {
+        const HullData* d = (const HullData*)dGeomGetClassData(o1);
+        Hull2D h;
+        footprint(o1,h);
+        const dReal* bp = dGeomGetPosition(o2);
+        const dReal r = dGeomSphereGetRadius(o2);
+        const dReal top = dGeomGetPosition(o1)[2] + d->height*0.5;
+        const dReal rel[2] = {bp[0]-h.c[0],bp[1]-h.c[1]};
+        const dReal p[2] = {dot2(rel,h.f),dot2(rel,h.t)};
+        const dReal dz = bp[2] - top;
+        if (dz >= r) return 0;
+        const bool kicker = d->kicker_depth > 0 && d->kicker_width > 0;
+
+        LocalContact lc[2];
+        int num = 0;
+        dReal qb[2],qk[2];
+        const bool outside_body = nearestOnBody(d,p,qb);
+        const bool outside_kicker = !kicker || nearestOnKicker(d,p,qk);
+        if (outside_body && outside_kicker)
+        {
+            // beside (or above the rim of) the hull: one contact per part in
+            // reach, two when the ball sits in the notch beside the kicker
+            const dReal* qs[2] = {qk,qb};
+            for (int i=kicker ? 0 : 1;i<2;i++)
+            {
+                const dReal v[3] = {p[0]-qs[i][0],p[1]-qs[i][1],std::max(dz,(dReal)0)};
+                const dReal dist = sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+                if (dist >= r || dist < 1e-9) continue;
+                if (i==1 && kicker && qb[0] >= d->front && fabs(qb[1]) <= d->kicker_width*0.5) continue; //behind the plate
+                LocalContact& c = lc[num++];
+                c.pos[0] = qs[i][0];
+                c.pos[1] = qs[i][1];
+                c.pos[2] = std::min(bp[2],top);
+                for (int k=0;k<3;k++) c.normal[k] = v[k]/dist;
+                c.depth = r - dist;
+            }
+        }
+        else
+        {
+            // center inside the footprint: push out through the top or the nearest side
+            dReal n[2] = {1,0},push;
+            if (!outside_body)
+            {
+                const dReal len = sqrt(dot2(p,p));
+                push = d->front - p[0];
+                if (d->radius - len < push && len > 1e-9)
+                {
+                    push = d->radius - len;
+                    n[0] = p[0]/len;
+                    n[1] = p[1]/len;
+                }
+            }
+            else
+            {
+                push = d->front + d->kicker_depth - p[0];
+                const dReal side = d->kicker_width*0.5 - fabs(p[1]);
+                if (side < push)
+                {
+                    push = side;
+                    n[0] = 0;
+                    n[1] = p[1] < 0 ? -1 : 1;
+                }
+            }
+            LocalContact& c = lc[num++];
+            if (dz > -push)
+            {
+                c.pos[0] = p[0];
+                c.pos[1] = p[1];
+                c.pos[2] = top;
+                c.normal[0] = c.normal[1] = 0;
+                c.normal[2] = 1;
+                c.depth = r - dz;
+            }
+            else
+            {
+                c.pos[0] = p[0] + push*n[0];
+                c.pos[1] = p[1] + push*n[1];
+                c.pos[2] = bp[2];
+                c.normal[0] = n[0];
+                c.normal[1] = n[1];
+                c.normal[2] = 0;
+                c.depth = r + push;
+            }
+        }
+        num = std::min(num,std::max(flags & 0xffff,1));
+        for (int i=0;i<num;i++)
+        {
+            dContactGeom* c = (dContactGeom*)((char*)contact + i*skip);
+            c->pos[0] = h.c[0] + lc[i].pos[0]*h.f[0] + lc[i].pos[1]*h.t[0];
+            c->pos[1] = h.c[1] + lc[i].pos[0]*h.f[1] + lc[i].pos[1]*h.t[1];
+            c->pos[2] = lc[i].pos[2];
+            c->normal[0] = -(lc[i].normal[0]*h.f[0] + lc[i].normal[1]*h.t[0]);
+            c->normal[1] = -(lc[i].normal[0]*h.f[1] + lc[i].normal[1]*h.t[1]);
+            c->normal[2] = -lc[i].normal[2];
+            c->depth = lc[i].depth;
+            c->g1 = o1;
+            c->g2 = o2;
+        }
+        return num;
+    }
+
+    dColliderFn* getCollider(int num)
+    {
+        if (num == hull_class) return &collideHullHull;
+        if (num == dSphereClass) return &collideHullSphere;
+        return 0;
+    }
+
+    void hullAABB(dGeomID g,dReal aabb[6])
+    {
+        const HullData* data = (const HullData*)dGeomGetClassData(g);
+        const dReal* pos = dGeomGetPosition(g);
+        const dReal kx = data->front + data->kicker_depth,ky = data->kicker_width*0.5;
+        const dReal reach = std::max(data->radius,sqrt(kx*kx + ky*ky));
+        aabb[0] = pos[0] - reach;
+        aabb[1] = pos[0] + reach;
+        aabb[2] = pos[1] - reach;
+        aabb[3] = pos[1] + reach;
+        aabb[4] = pos[2] - data->height*0.5;
+        aabb[5] = pos[2] + data->height*0.5;
+    }
+}
+
+int dRobotHullClass()
+{
+    if (hull_class == -1)
+    {
+        dGeomClass c;
+        c.bytes = sizeof(HullData);
+        c.collider = &getCollider;
+        c.aabb = &hullAABB;
+        c.aabb_test = 0;
+        c.dtor = 0;
+        hull_class = dCreateGeomClass(&c);
+    }
+    return hull_class;
+}
+
+void dRobotHullCloseClass()
+{
+    hull_class = -1;
+}
+
+dGeomID dCreateRobotHull(dSpaceID space,dReal radius,dReal front,dReal height)
+{
+    dGeomID g = dCreateGeom(dRobotHullClass());
+    HullData* data = (HullData*)dGeomGetClassData(g);
+    data->radius = radius;
+    data->front = front;
+    data->height = height;
+    data->kicker_depth = data->kicker_width = 0;
+    if (space) dSpaceAdd(space,g);
+    return g;
+}
+
+void dGeomRobotHullGetParams(dGeomID g,dReal* radius,dReal* front,dReal* height)
+{
+    const HullData* data = (const HullData*)dGeomGetClassData(g);
+    *radius = data->radius;
+    *front = data->front;
+    *height = data->height;
+}
+
+void dGeomRobotHullSetKicker(dGeomID g,dReal depth,dReal width)
+{
+    HullData* data = (HullData*)dGeomGetClassData(g);
+    data->kicker_depth = depth;
+    data->kicker_width = width;
+}
+
+void dGeomRobotHullGetKicker(dGeomID g,dReal* depth,dReal* width)
+{
+    const HullData* data = (const HullData*)dGeomGetClassData(g);
+    *depth = data->kicker_depth;
+    *width = data->kicker_width;
+}
+
+bool dGeomRobotHullOnKicker(dGeomID g,const dReal* pos)
+{
+    const HullData* data = (const HullData*)dGeomGetClassData(g);
+    if (data->kicker_depth <= 0) return false;
+    Hull2D h;
+    footprint(g,h);
+    const dReal rel[2] = {pos[0]-h.c[0],pos[1]-h.c[1]};
+    return dot2(rel,h.f) > data->front + data->kicker_depth - 1e-4 && fabs(dot2(rel,h.t)) <= data->kicker_width*0.5 + 1e-4;
+}
+
+PRobotHull::PRobotHull(dReal x,dReal y,dReal z,dReal radius,dReal front,dReal height,dReal mass)
+          : PObject(x,y,z,0,0,0,mass)
+{
+    m_radius = radius;
+    m_front = front;
+    m_height = height;
+    m_kicker_depth = m_kicker_width = 0;
+    visible = false;
+}
+
+PRobotHull::~PRobotHull()
+{
+}
+
+void PRobotHull::setKicker(dReal depth,dReal width)
+{
+    m_kicker_depth = depth;
+    m_kicker_width = width;
+    if (geom!=NULL) dGeomRobotHullSetKicker(geom,depth,width);
+}
+
+void PRobotHull::setMass(dReal mass)
+{
+    m_mass = mass;
+    dMass m;
+    dMassSetCylinderTotal(&m,m_mass,3,m_radius,m_height);
+    dBodySetMass(body,&m);
+}
+
+void PRobotHull::init()
+{
+    geom = dCreateRobotHull(0,m_radius,m_front,m_height);
+    dGeomRobotHullSetKicker(geom,m_kicker_depth,m_kicker_width);
+    if (parent!=NULL) attachToParent();
+    else
+    {
+        body = dBodyCreate(world);
+        initPosBody();
+        setMass(m_mass);
+        dGeomSetBody(geom,body);
+    }
+    dSpaceAdd(space,geom);
+}
+
+void PRobotHull::draw()
+{
+}
@@ -0,0 +1,156 @@
+/*
+grSim - RoboCup Small Size Soccer Robots Simulator
+Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pstats.h"
+
+namespace {
+    void clearCounts(PCollisionCounts& c)
+    {
+        c.pairs = c.rejected = c.collides = c.contacts = 0;
+    }
+}
+
+PCollisionStats::PCollisionStats(int history)
+{
+    samples.resize(history > 0 ? history : 1);
+    head = filled = steps = 0;
+    clearCounts(current);
+    csv = NULL;
+    addType("other");
+}
+
+PCollisionStats::~PCollisionStats()
+{
+    setCsvFile("");
+}
+
+int PCollisionStats::addType(const QString& name)
+{
+    int i = names.indexOf(name);
+    if (i >= 0) return i;
+    names.append(name);
+    PCollisionCounts c;
+    clearCounts(c);
+    current_types.append(c);
+    for (auto & sample : samples) sample.types.append(c);
+    if (csv != NULL) writeCsvHeader(); //new column, start a new table
+    return names.count() - 1;
+}
+
+int PCollisionStats::typeCount()
+{
+    return names.count();
+}
+
+QString PCollisionStats::typeName(int type)
+{
+    return names.value(type);
+}
+
+void PCollisionStats::beginStep()
+{
+    clearCounts(current);
+    for (auto & c : current_types) clearCounts(c);
+}
+
+void PCollisionStats::countCollide(int type,int contacts)
+{
+    current.collides++;
+    current.contacts += contacts;
+    current_types[type].collides++;
+    current_types[type].contacts += contacts;
+}
+
+void PCollisionStats::endStep()
+{
+    Sample& s = samples[head];
+    s.total = current;
+    s.types = current_types;
+    head = (head + 1) % samples.count();
+    if (filled < samples.count()) filled++;
+    steps++;
+    if (csv == NULL) return;
+    csv_stream << steps << ',' << current.pairs << ',' << current.rejected << ',' << current.collides << ',' << current.contacts;
+    for (auto & c : current_types) csv_stream << ',' << c.contacts;
+    csv_stream << '\n';
+}
+
+PCollisionCounts PCollisionStats::last()
+{
+    if (filled == 0) {PCollisionCounts c; clearCounts(c); return c;}
+    return samples[(head + samples.count() - 1) % samples.count()].total;
+}
+
+PCollisionCounts PCollisionStats::last(int type)
+{
+    if (filled == 0 || type < 0 || type >= names.count()) {PCollisionCounts c; clearCounts(c); return c;}
+    return samples[(head + samples.count() - 1) % samples.count()].types[type];
+}
+
+QVector<int> PCollisionStats::contactHistogram(int type,int bin_width,int bin_count)
+{
+    QVector<int> bins(bin_count > 0 ? bin_count : 1,0);
+    if (bin_width < 1) bin_width = 1;
+    for (int i=0;i<filled;i++)
+    {
+        const Sample& s = samples[i];
+        const int contacts = (type < 0) ? s.total.contacts : s.types.value(type).contacts;
+        bins[qMin(contacts/bin_width,bins.count()-1)]++;
+    }
+    return bins;
+}
+
+int PCollisionStats::peakContacts(int type)
+{
+    int peak = 0;
+    for (int i=0;i<filled;i++)
+    {
+        const Sample& s = samples[i];
+        peak = qMax(peak,(type < 0) ? s.total.contacts : s.types.value(type).contacts);
+    }
+    return peak;
+}
+
+bool PCollisionStats::setCsvFile(const QString& filename)
+{
+    if (csv != NULL)
+    {
+        csv_stream.flush();
+        csv_stream.setDevice(NULL);
+        delete csv;
+        csv = NULL;
+    }
+    if (filename.isEmpty()) return true;
+    csv = new QFile(filename);
+    if (!csv->open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        delete csv;
+        csv = NULL;
+        return false;
+    }
+    csv_stream.setDevice(csv);
+    writeCsvHeader();
+    return true;
+}
+
+void PCollisionStats::writeCsvHeader()
+{
+    csv_stream << "step,pairs,rejected,collides,contacts";
+    for (auto & name : names) csv_stream << ',' << name;
+    csv_stream << '\n';
+}
@@ -0,0 +1,211 @@
+/*
+grSim - RoboCup Small Size Soccer Robots Simulator
+Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "psweep.h"
+#include "probothull.h"
+#include <cmath>
+#include <utility>
+
+static void toLocal(const dReal* v,const dReal* R,dReal* out)
+{
+    // R^T * v, ODE matrices are row major with a stride of 4
+    for (int j=0;j<3;j++)
+        out[j] = R[j]*v[0] + R[4+j]*v[1] + R[8+j]*v[2];
+}
+
+// narrows [tmin,tmax] to where lo <= x + dx*t <= hi, false if nothing is left
+static bool clipSlab(dReal x,dReal dx,dReal lo,dReal hi,dReal& tmin,dReal& tmax)
+{
+    if (fabs(dx) < 1e-12) return x >= lo && x <= hi;
+    dReal t1 = (lo - x) / dx;
+    dReal t2 = (hi - x) / dx;
+    if (t1 > t2) std::swap(t1,t2);
+    if (t1 > tmin) tmin = t1;
+    if (t2 < tmax) tmax = t2;
+    return tmin <= tmax;
+}
+
+dReal sweepSphereSphere(const dReal* p,const dReal* d,dReal r,const dReal* center,dReal radius)
+{
+    const dReal m[3] = {p[0]-center[0],p[1]-center[1],p[2]-center[2]};
+    const dReal R = r + radius;
+    const dReal a = d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+    const dReal b = m[0]*d[0] + m[1]*d[1] + m[2]*d[2];
+    const dReal c = m[0]*m[0] + m[1]*m[1] + m[2]*m[2] - R*R;
+    if (c <= 0) return 0;
+    if (b >= 0 || a <= 0) return -1;
+    const dReal disc = b*b - a*c;
+    if (disc < 0) return -1;
+    const dReal t = (-b - sqrt(disc)) / a;
+    return (t <= 1) ? t : -1;
+}
+
+dReal sweepSphereBox(const dReal* p,const dReal* d,dReal r,const dReal* center,const dReal* R,const dReal* sides)
+{
+    // slab test against the box inflated by r, the rounded edges
+    // of the exact Minkowski sum are treated as sharp
+    const dReal m[3] = {p[0]-center[0],p[1]-center[1],p[2]-center[2]};
+    dReal lp[3],ld[3];
+    toLocal(m,R,lp);
+    toLocal(d,R,ld);
+    dReal tmin = 0,tmax = 1;
+    for (int i=0;i<3;i++)
+    {
+        const dReal h = sides[i]*0.5 + r;
+        if (fabs(ld[i]) < 1e-12)
+        {
+            if (fabs(lp[i]) > h) return -1;
+            continue;
+        }
+        dReal t1 = (-h - lp[i]) / ld[i];
+        dReal t2 = ( h - lp[i]) / ld[i];
+        if (t1 > t2) std::swap(t1,t2);
+        if (t1 > tmin) tmin = t1;
+        if (t2 < tmax) tmax = t2;
+        if (tmin > tmax) return -1;
+    }
+    return tmin;
+}
+
+dReal sweepSphereCylinder(const dReal* p,const dReal* d,dReal r,const dReal* center,const dReal* R,dReal radius,dReal length)
+{
+    // ODE cylinders are aligned with their local z axis
+    const dReal m[3] = {p[0]-center[0],p[1]-center[1],p[2]-center[2]};
+    dReal lp[3],ld[3];
+    toLocal(m,R,lp);
+    toLocal(d,R,ld);
+    const dReal h = length*0.5 + r;
+    const dReal rr = radius + r;
+    dReal tmin = 0,tmax = 1;
+    if (fabs(ld[2]) < 1e-12)
+    {
+        if (fabs(lp[2]) > h) return -1;
+    }
+    else
+    {
+        dReal t1 = (-h - lp[2]) / ld[2];
+        dReal t2 = ( h - lp[2]) / ld[2];
+        if (t1 > t2) std::swap(t1,t2);
+        if (t1 > tmin) tmin = t1;
+        if (t2 < tmax) tmax = t2;
+    }
+    const dReal a = ld[0]*ld[0] + ld[1]*ld[1];
+    const dReal b = lp[0]*ld[0] + lp[1]*ld[1];
+    const dReal c = lp[0]*lp[0] + lp[1]*lp[1] - rr*rr;
+    if (a < 1e-12)
+    {
+        if (c > 0) return -1;
+    }
+    else
+    {
+        const dReal disc = b*b - a*c;
+        if (disc < 0) return -1;
+        const dReal sq = sqrt(disc);
+        const dReal t1 = (-b - sq) / a;
+        const dReal t2 = (-b + sq) / a;
+        if (t1 > tmin) tmin = t1;
+        if (t2 < tmax) tmax = t2;
+    }
+    if (tmin > tmax) return -1;
+    return tmin;
+}
+
+dReal sweepSphereHull(const dReal* p,const dReal* d,dReal r,const dReal* center,const dReal* R,
+                      dReal radius,dReal front,dReal height,dReal kicker_depth,dReal kicker_width)
+{
+    // the hull is the union of the cut circle and the kicker plate, each one
+    // inflated by r with sharp edges as in sweepSphereBox; the first touch is
+    // the earlier of the two entries
+    const dReal len = sqrt(R[0]*R[0] + R[4]*R[4]);
+    const dReal f[2] = {R[0]/len,R[4]/len};
+    const dReal m[3] = {p[0]-center[0],p[1]-center[1],p[2]-center[2]};
+    const dReal lp[3] = {m[0]*f[0] + m[1]*f[1],m[1]*f[0] - m[0]*f[1],m[2]};
+    const dReal ld[3] = {d[0]*f[0] + d[1]*f[1],d[1]*f[0] - d[0]*f[1],d[2]};
+    const dReal h = height*0.5 + r;
+    dReal best = -1;
+
+    dReal tmin = 0,tmax = 1;
+    if (clipSlab(lp[2],ld[2],-h,h,tmin,tmax) && clipSlab(lp[0],ld[0],-dInfinity,front + r,tmin,tmax))
+    {
+        const dReal rr = radius + r;
+        const dReal a = ld[0]*ld[0] + ld[1]*ld[1];
+        const dReal b = lp[0]*ld[0] + lp[1]*ld[1];
+        const dReal c = lp[0]*lp[0] + lp[1]*lp[1] - rr*rr;
+        bool hit = true;
+        if (a < 1e-12) hit = c <= 0;
+        else
+        {
+            const dReal disc = b*b - a*c;
+            if (disc < 0) hit = false;
+            else
+            {
+                const dReal sq = sqrt(disc);
+                const dReal t1 = (-b - sq) / a;
+                const dReal t2 = (-b + sq) / a;
+                if (t1 > tmin) tmin = t1;
+                if (t2 < tmax) tmax = t2;
+                hit = tmin <= tmax;
+            }
+        }
+        if (hit) best = tmin;
+    }
+
+    if (kicker_depth > 0 && kicker_width > 0)
+    {
+        const dReal w = kicker_width*0.5 + r;
+        tmin = 0;
+        tmax = 1;
+        if (clipSlab(lp[2],ld[2],-h,h,tmin,tmax) &&
+            clipSlab(lp[0],ld[0],front - r,front + kicker_depth + r,tmin,tmax) &&
+            clipSlab(lp[1],ld[1],-w,w,tmin,tmax) &&
+            (best < 0 || tmin < best))
+            best = tmin;
+    }
+    return best;
+}
+
+dReal sweepSphereGeom(const dReal* p,const dReal* d,dReal r,dGeomID geom)
+{
+    const dReal* pos = dGeomGetPosition(geom);
+    switch (dGeomGetClass(geom))
+    {
+    case dSphereClass:
+        return sweepSphereSphere(p,d,r,pos,dGeomSphereGetRadius(geom));
+    case dBoxClass:
+    {
+        dVector3 sides;
+        dGeomBoxGetLengths(geom,sides);
+        return sweepSphereBox(p,d,r,pos,dGeomGetRotation(geom),sides);
+    }
+    case dCylinderClass:
+    {
+        dReal radius,length;
+        dGeomCylinderGetParams(geom,&radius,&length);
+        return sweepSphereCylinder(p,d,r,pos,dGeomGetRotation(geom),radius,length);
+    }
+    default:
+        if (dGeomGetClass(geom) == dRobotHullClass())
+        {
+            dReal radius,front,height,depth,width;
+            dGeomRobotHullGetParams(geom,&radius,&front,&height);
+            dGeomRobotHullGetKicker(geom,&depth,&width);
+            return sweepSphereHull(p,d,r,pos,dGeomGetRotation(geom),radius,front,height,depth,width);
+        }
+        return -1;
+    }
+}
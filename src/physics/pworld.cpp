@@ -17,9 +17,79 @@ Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
 */
 
 #include "pworld.h"
+#include "probothull.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+    inline quint64 pairKey(int a,int b)
+    {
+        if (a > b) std::swap(a,b);
+        return ((quint64)(quint32)a << 32) | (quint32)b;
+    }
+
+    // ODE's step memory hooks carry no user pointer, so the counters are
+    // shared by all worlds (grSim only has one at a time)
+    size_t step_memory = 0;
+    size_t peak_step_memory = 0;
+    int step_allocations = 0;
+
+    void* allocStepBlock(size_t size)
+    {
+        step_allocations++;
+        step_memory += size;
+        if (step_memory > peak_step_memory) peak_step_memory = step_memory;
+        return malloc(size);
+    }
+
+    // shrink in place, moving the block to give back memory is not worth a copy
+    void* shrinkStepBlock(void* block,size_t current,size_t smaller)
+    {
+        step_memory -= current - smaller;
+        return block;
+    }
+
+    void freeStepBlock(void* block,size_t size)
+    {
+        step_memory -= size;
+        free(block);
+    }
+
+    // ODE exits after its error and debug handlers return, throwing hands the
+    // failure to the catch in PWorld::runStep instead. A failure on an island
+    // thread still terminates, as it did before
+    void throwODEFailure(int num,const char* msg,va_list ap)
+    {
+        char text[512];
+        vsnprintf(text,sizeof(text),msg,ap);
+        throw std::runtime_error(QString("ODE error %1: %2").arg(num).arg(text).toStdString());
+    }
+
+    // warnings (e.g. LCP internal errors) do not stop the step, they are
+    // kept and reported with it. Island threads may report at the same time
+    QString step_warning;
+    QMutex step_warning_mutex;
+    void recordODEMessage(int num,const char* msg,va_list ap)
+    {
+        char text[512];
+        vsnprintf(text,sizeof(text),msg,ap);
+        QMutexLocker lock(&step_warning_mutex);
+        step_warning = QString("ODE message %1: %2").arg(num).arg(text);
+    }
+}
+
 PSurface::PSurface()
 {
   callback = NULL;
+  data = NULL;
+  type = 0;
   usefdir1 = false;
   surface.mode = dContactApprox1;
   surface.mu = 0.5;
@@ -36,28 +106,118 @@ void nearCallback (void *data, dGeomID o1, dGeomID o2)
 }
 
 
-PWorld::PWorld(dReal dt,dReal gravity,CGraphics* graphics, int _robot_count)
+PWorld::PWorld(dReal dt,dReal gravity,CGraphics* graphics, int _robot_count, int threads)
 {
     robot_count = _robot_count;
     //dInitODE2(0);
     dInitODE();
+    dSetErrorHandler(throwODEFailure);
+    dSetDebugHandler(throwODEFailure);
+    dSetMessageHandler(recordODEMessage);
     world = dWorldCreate();
     space = dHashSpaceCreate (0);
     contactgroup = dJointGroupCreate (0);
     dWorldSetGravity (world,0,0,-gravity);
     objects_count = 0;
-    sur_matrix = NULL;
     //dAllocateODEDataForThread(dAllocateMaskAll);
     delta_time = dt;
     g = graphics;
+#ifdef HAVE_ODE_THREADING
+    threading = NULL;
+    thread_pool = NULL;
+#endif
+    thread_count = 0;
+    initThreading(threads);
+    initStepMemory();
+    peak_contacts = 0;
+    frame_steps = last_frame_steps = 0;
+    step_errors = 0;
+    determinism_check = false;
+    determinism_checks = determinism_mismatches = 0;
+}
+
+void PWorld::initStepMemory()
+{
+    //the previous world has given its blocks back, start the counters over
+    step_memory = peak_step_memory = 0;
+    step_allocations = 0;
+    //reserve generously up front so a crowded step does not reallocate the working memory
+    dWorldStepReserveInfo reserve;
+    reserve.struct_size = sizeof(reserve);
+    reserve.reserve_factor = 1.5f;
+    reserve.reserve_minimum = 512*1024;
+    dWorldSetStepMemoryReservationPolicy(world,&reserve);
+    dWorldStepMemoryFunctionsInfo functions;
+    functions.struct_size = sizeof(functions);
+    functions.alloc_block = &allocStepBlock;
+    functions.shrink_block = &shrinkStepBlock;
+    functions.free_block = &freeStepBlock;
+    dWorldSetStepMemoryManager(world,&functions);
+}
+
+PWorldStats PWorld::stats()
+{
+    PWorldStats st;
+    st.contacts = collisionStats.last().contacts;
+    st.peak_contacts = peak_contacts;
+    st.step_memory = step_memory;
+    st.peak_step_memory = peak_step_memory;
+    st.step_allocations = step_allocations;
+    st.step_errors = step_errors;
+    st.substeps = last_frame_steps;
+    st.determinism_checks = determinism_checks;
+    st.determinism_mismatches = determinism_mismatches;
+    return st;
+}
+
+void PWorld::initThreading(int threads)
+{
+#ifdef HAVE_ODE_THREADING
+    if (threads <= 0) return;
+    threading = dThreadingAllocateMultiThreadedImplementation();
+    if (threading == NULL) return; //ODE was built without its own threading implementation
+    thread_pool = dThreadingAllocateThreadPool(threads, 0, dAllocateFlagBasicData, NULL);
+    if (thread_pool == NULL)
+    {
+        dThreadingFreeImplementation(threading);
+        threading = NULL;
+        return;
+    }
+    dThreadingThreadPoolServeMultiThreadedImplementation(thread_pool, threading);
+    dWorldSetStepThreadingImplementation(world, dThreadingImplementationGetFunctions(threading), threading);
+    //the number of islands stepped at once. Collision runs on the caller's
+    //thread and islands are built serially, each body belongs to exactly one
+    //island and every island is solved into its own bodies, so the threads
+    //should reproduce the serial result bit for bit. setDeterminismCheck()
+    //verifies that on the running world
+    dWorldSetStepIslandsProcessingMaxThreadCount(world, threads);
+    thread_count = threads;
+#else
+    (void)threads;
+#endif
+}
+
+int PWorld::threadCount()
+{
+    return thread_count;
 }
 
 PWorld::~PWorld()
 {
+#ifdef HAVE_ODE_THREADING
+  if (threading != NULL)
+  {
+      dThreadingImplementationShutdownProcessing(threading);
+      dThreadingFreeThreadPool(thread_pool);
+      dWorldSetStepThreadingImplementation(world, NULL, NULL);
+      dThreadingFreeImplementation(threading);
+  }
+#endif
   dJointGroupDestroy (contactgroup);
   dSpaceDestroy (space);
   dWorldDestroy (world);
   dCloseODE();
+  dRobotHullCloseClass(); //registered again by the next world
 }
 
 void PWorld::setGravity(dReal gravity)
@@ -65,15 +225,29 @@ void PWorld::setGravity(dReal gravity)
     dWorldSetGravity (world,0,0,-gravity);
 }
 
+void PWorld::setAutoDisable(bool enabled)
+{
+    //bodies take these defaults when they are created
+    dWorldSetAutoDisableFlag(world,enabled ? 1 : 0);
+    dWorldSetAutoDisableLinearThreshold(world,0.01);
+    dWorldSetAutoDisableAngularThreshold(world,0.02);
+    dWorldSetAutoDisableAverageSamplesCount(world,10);
+    dWorldSetAutoDisableSteps(world,20);
+    dWorldSetAutoDisableTime(world,0);
+}
+
 void PWorld::handleCollisions(dGeomID o1, dGeomID o2)
 {   
     PSurface* sur;
-    int j=sur_matrix[*((int*)(dGeomGetData(o1)))][*((int*)(dGeomGetData(o2)))];
-    if (j!=-1)
+    collisionStats.countPair();
+    int j=surfaceIndex(o1,o2);
+    if (j==-1) collisionStats.countRejected();
+    else
     {
         const int N = 10;
         dContact contact[N];
         int n = dCollide (o1,o2,N,&contact[0].geom,sizeof(dContact));
+        int created = 0;
         if (n > 0) {
           sur = surfaces[j];
           sur->contactPos   [0] = contact[0].geom.pos[0];
@@ -95,12 +269,14 @@ void PWorld::handleCollisions(dGeomID o1, dGeomID o2)
                   contact[i].fdir1[3] = sur->fdir1[3];
               }
               dJointID c = dJointCreateContact (world,contactgroup,&contact[i]);
+              created++;
 
               dJointAttach (c,
                             dGeomGetBody(contact[i].geom.g1),
                             dGeomGetBody(contact[i].geom.g2));
             }
         }
+        collisionStats.countCollide(surfaces[j]->type,created);
     }
 
 }
@@ -115,46 +291,54 @@ void PWorld::addObject(PObject* o)
     o->init();
     dGeomSetData(o->geom,(void*)(&(o->id)));
     objects.append(o);
+    groups.append(-1);
 }
 
 void PWorld::initAllObjects()
 {
+    //surfaces are looked up by object id, nothing is sized by the object count
     objects_count = objects.count();
-    int c = objects_count;
-    bool flag = false;
-    if (sur_matrix!=NULL)
-    {
-        for (int i=0;i<c;i++)
-            delete sur_matrix[i];
-        delete sur_matrix;
-        flag = true;
-    }    
-    sur_matrix = new int* [c];
-    for (int i=0;i<c;i++)
-    {
-        sur_matrix[i] = new int [c];    
-        for (int j=0;j<c;j++)
-            sur_matrix[i][j] = -1;
-    }
-    if (flag)
-    {
-        for (int i=0;i<surfaces.count();i++)
-            sur_matrix[(*(int*)(dGeomGetData(surfaces[i]->id1)))][*((int*)(dGeomGetData(surfaces[i]->id2)))] =
-            sur_matrix[(*(int*)(dGeomGetData(surfaces[i]->id2)))][*((int*)(dGeomGetData(surfaces[i]->id1)))] = i;
-    }
 }
 
-PSurface* PWorld::createSurface(PObject* o1,PObject* o2)
+PSurface* PWorld::createSurface(PObject* o1,PObject* o2,const QString& type)
 {
     PSurface *s = new PSurface();
     s->id1 = o1->geom;
     s->id2 = o2->geom;
+    s->type = collisionStats.addType(type);
     surfaces.append(s);
-    sur_matrix[o1->id][o2->id] =
-    sur_matrix[o2->id][o1->id] = surfaces.count() - 1;
+    pair_surfaces[pairKey(o1->id,o2->id)] = surfaces.count() - 1;
     return s;
 }
 
+void PWorld::setGroup(PObject* o,int group)
+{
+    groups[o->id] = group;
+}
+
+PSurface* PWorld::createGroupSurface(int group1,int group2,const QString& type)
+{
+    PSurface *s = new PSurface();
+    s->id1 = s->id2 = 0;
+    s->type = collisionStats.addType(type);
+    surfaces.append(s);
+    group_surfaces[pairKey(group1,group2)] = surfaces.count() - 1;
+    return s;
+}
+
+int PWorld::surfaceIndex(dGeomID o1,dGeomID o2)
+{
+    const int i1 = *((int*)(dGeomGetData(o1))),i2 = *((int*)(dGeomGetData(o2)));
+    QMap<quint64,int>::const_iterator it = pair_surfaces.constFind(pairKey(i1,i2));
+    if (it != pair_surfaces.constEnd()) return it.value();
+    if (groups[i1] < 0 || groups[i2] < 0) return -1;
+    it = group_surfaces.constFind(pairKey(groups[i1],groups[i2]));
+    if (it == group_surfaces.constEnd()) return -1;
+    dBodyID b1 = dGeomGetBody(o1),b2 = dGeomGetBody(o2);
+    if (b1 == b2 || (b1 != NULL && b2 != NULL && dAreConnected(b1,b2))) return -1;
+    return it.value();
+}
+
 PSurface* PWorld::findSurface(PObject* o1,PObject* o2)
 {
     for (int i=0;i<surfaces.count();i++)
@@ -166,14 +350,119 @@ PSurface* PWorld::findSurface(PObject* o1,PObject* o2)
 
 void PWorld::step(dReal dt)
 {
+    frame_steps++;
+#ifdef HAVE_ODE_THREADING
+    if (determinism_check && threading != NULL)
+    {
+        saveState();
+        dWorldSetStepThreadingImplementation(world, NULL, NULL);
+        runStep(dt);
+        const quint64 serial = stateHash();
+        restoreState();
+        dWorldSetStepThreadingImplementation(world, dThreadingImplementationGetFunctions(threading), threading);
+        runStep(dt);
+        determinism_checks++;
+        if (stateHash() != serial) determinism_mismatches++;
+        return;
+    }
+#endif
+    runStep(dt);
+}
+
+void PWorld::runStep(dReal dt)
+{
+    step_warning.clear();
     try {
+        collisionStats.beginStep();
         dSpaceCollide (space,this,&nearCallback);
+        collisionStats.endStep();
+        peak_contacts = qMax(peak_contacts,collisionStats.last().contacts);
         dWorldStep(world,(dt<0) ? delta_time : dt);
-        dJointGroupEmpty (contactgroup);
+    }
+    catch (const std::exception& e) {
+        step_errors++;
+        last_step_error = e.what();
     }
     catch (...) {
-        //qDebug() << "Some Error Happened;";
+        step_errors++;
+        last_step_error = "unknown exception";
     }
+    if (!step_warning.isEmpty())
+    {
+        step_errors++;
+        last_step_error = step_warning;
+    }
+    dJointGroupEmpty (contactgroup);
+}
+
+void PWorld::setDeterminismCheck(bool enabled)
+{
+    determinism_check = enabled;
+}
+
+void PWorld::saveState()
+{
+    // forces are part of the state, the first step clears what the caller added
+    saved_state.clear();
+    for (PObject* o : objects)
+    {
+        if (o->body == NULL || o->parent != NULL) continue;
+        BodyState st;
+        st.body = o->body;
+        memcpy(st.pos,dBodyGetPosition(o->body),sizeof(st.pos));
+        memcpy(st.q,dBodyGetQuaternion(o->body),sizeof(st.q));
+        memcpy(st.lvel,dBodyGetLinearVel(o->body),sizeof(st.lvel));
+        memcpy(st.avel,dBodyGetAngularVel(o->body),sizeof(st.avel));
+        memcpy(st.force,dBodyGetForce(o->body),sizeof(st.force));
+        memcpy(st.torque,dBodyGetTorque(o->body),sizeof(st.torque));
+        st.enabled = dBodyIsEnabled(o->body);
+        saved_state.append(st);
+    }
+}
+
+void PWorld::restoreState()
+{
+    for (const BodyState& st : saved_state)
+    {
+        dBodySetPosition(st.body,st.pos[0],st.pos[1],st.pos[2]);
+        dBodySetQuaternion(st.body,st.q);
+        dBodySetLinearVel(st.body,st.lvel[0],st.lvel[1],st.lvel[2]);
+        dBodySetAngularVel(st.body,st.avel[0],st.avel[1],st.avel[2]);
+        dBodySetForce(st.body,st.force[0],st.force[1],st.force[2]);
+        dBodySetTorque(st.body,st.torque[0],st.torque[1],st.torque[2]);
+        if (st.enabled) dBodyEnable(st.body);
+        else dBodyDisable(st.body);
+    }
+}
+
+quint64 PWorld::stateHash()
+{
+    // FNV-1a over the bits of every body's pose and velocity
+    quint64 h = 14695981039346656037ULL;
+    auto add = [&h](const dReal* v,int n) {
+        const unsigned char* b = (const unsigned char*)v;
+        for (size_t i=0;i<n*sizeof(dReal);i++) {h ^= b[i];h *= 1099511628211ULL;}
+    };
+    for (PObject* o : objects)
+    {
+        if (o->body == NULL || o->parent != NULL) continue;
+        add(dBodyGetPosition(o->body),3);
+        add(dBodyGetQuaternion(o->body),4);
+        add(dBodyGetLinearVel(o->body),3);
+        add(dBodyGetAngularVel(o->body),3);
+    }
+    return h;
+}
+
+void PWorld::endFrame()
+{
+    last_frame_steps = frame_steps;
+    frame_steps = 0;
+}
+
+QString PWorld::lastStepError()
+{
+    return last_step_error;
 }
 
 void PWorld::draw()
@@ -17,6 +17,7 @@ Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
 */
 
 #include "robot.h"
+#include <algorithm>
 // #include <iostream>
 
 // ang2 = position angle
@@ -39,8 +40,20 @@ Robot::Wheel::Wheel(Robot* robot,int _id,dReal ang,dReal ang2,int wheeltexid)
     cyl->setBodyRotation(-sin(ang),cos(ang),0,M_PI*0.5,true);       //set local rotation matrix
     cyl->setBodyPosition(centerx-x,centery-y,centerz-z,true);       //set local position vector
     cyl->space = rob->space;
+    if (rob->m_model != FULL_MODEL) cyl->setParent(rob->chassis);
 
     rob->w->addObject(cyl);
+    speed = motor_speed = encoder = 0;
+    joint = motor = 0;
+    max_acceleration = rob->cfg->robotSettings.WheelMaxAcceleration;
+    fmax = rob->cfg->robotSettings.Wheel_Motor_FMax;
+    kp = rob->cfg->robotSettings.WheelMotorKp;
+    ki = rob->cfg->robotSettings.WheelMotorKi;
+    const dReal rate = rob->cfg->robotSettings.WheelMotorControlRate;
+    control_period = (rate > 0) ? 1.0/rate : 0;
+    control_clock = control_period;
+    integral = torque = 0;
+    if (rob->m_model != FULL_MODEL) return;
 
     joint = dJointCreateHinge (rob->w->world,0);
 
@@ -53,17 +66,47 @@ Robot::Wheel::Wheel(Robot* robot,int _id,dReal ang,dReal ang2,int wheeltexid)
     dJointAttach(motor,rob->chassis->body,cyl->body);
     dJointSetAMotorNumAxes(motor,1);
     dJointSetAMotorAxis(motor,0,1,cos(ang),sin(ang),0);
-    dJointSetAMotorParam(motor,dParamFMax,rob->cfg->robotSettings.Wheel_Motor_FMax);
-    speed = 0;
+    //the PI controller drives the wheel through torques, the motor only limits them
+    dJointSetAMotorParam(motor,dParamFMax,(kp > 0 || ki > 0) ? 0 : fmax);
 }
 
-void Robot::Wheel::step()
+void Robot::Wheel::step(dReal dt)
 {
-    dJointSetAMotorParam(motor,dParamVel,speed);
-    dJointSetAMotorParam(motor,dParamFMax,rob->cfg->robotSettings.Wheel_Motor_FMax);
+    //firmware motor loop on its own clock: each tick ramps the setpoint to the
+    //command and, with gains set, runs the PI speed controller. Ticks falling
+    //into one physics step share its measured speed, their torques are
+    //averaged and held over the step like a motor driver holds its output
+    const dReal rate = dJointGetHingeAngleRate(joint);
+    const bool pi = kp > 0 || ki > 0;
+    const dReal period = (control_period > 0) ? control_period : dt;
+    if (control_period <= 0) control_clock = dt;
+    else control_clock += dt;
+    dReal sum = 0;
+    int ticks = 0;
+    while (control_clock >= period*(1 - 1e-9))
+    {
+        control_clock -= period;
+        ticks++;
+        const dReal dv = max_acceleration*period;
+        if (dv <= 0) motor_speed = speed;
+        else motor_speed += std::max(-dv,std::min(speed - motor_speed,dv));
+        if (!pi) continue;
+        const dReal e = motor_speed - rate;
+        if (ki > 0) integral = std::max(-fmax/ki,std::min(integral + e*period,fmax/ki)); //no windup past the torque limit
+        sum += std::max(-fmax,std::min(kp*e + ki*integral,fmax));
+    }
+    control_clock = std::max(control_clock,(dReal)0);
+    if (!pi) dJointSetAMotorParam(motor,dParamVel,motor_speed);
+    else
+    {
+        if (ticks > 0) torque = sum/ticks;
+        //the world step clears applied torques, so the held value is added every step
+        dJointAddAMotorTorques(motor,torque,0,0);
+    }
+    encoder += rate*dt;
 }
 
-Robot::Kicker::Kicker(Robot* robot) : holdingBall(false)
+Robot::Kicker::Kicker(Robot* robot) : touchingBall(false), ball_along(0), holdingBall(false)
 {
     rob = robot;
 
@@ -76,18 +119,27 @@ Robot::Kicker::Kicker(Robot* robot) : holdingBall(false)
     box = new PBox(centerx,centery,centerz,rob->cfg->robotSettings.KickerThickness,rob->cfg->robotSettings.KickerWidth,rob->cfg->robotSettings.KickerHeight,rob->cfg->robotSettings.KickerMass,0.9,0.9,0.9);
     box->setBodyPosition(centerx-x,centery-y,centerz-z,true);
     box->space = rob->space;
+    if (rob->m_model != FULL_MODEL) box->setParent(rob->chassis);
 
     rob->w->addObject(box);
 
-    joint = dJointCreateHinge (rob->w->world,0);
-    dJointAttach (joint,rob->chassis->body,box->body);
-    const dReal *aa = dBodyGetPosition (box->body);
-    dJointSetHingeAnchor (joint,aa[0],aa[1],aa[2]);
-    dJointSetHingeAxis (joint,0,-1,0);
+    joint = 0;
+    if (rob->m_model == FULL_MODEL)
+    {
+        joint = dJointCreateHinge (rob->w->world,0);
+        dJointAttach (joint,rob->chassis->body,box->body);
+        const dReal *aa = dBodyGetPosition (box->body);
+        dJointSetHingeAnchor (joint,aa[0],aa[1],aa[2]);
+        dJointSetHingeAxis (joint,0,-1,0);
+
+        dJointSetHingeParam (joint,dParamVel,0);
+        dJointSetHingeParam (joint,dParamLoStop,0);
+        dJointSetHingeParam (joint,dParamHiStop,0);
+    }
 
-    dJointSetHingeParam (joint,dParamVel,0);
-    dJointSetHingeParam (joint,dParamLoStop,0);
-    dJointSetHingeParam (joint,dParamHiStop,0);
+    //the dribble joint lives as long as the robot, holding the ball only attaches and enables it
+    robot_to_ball = dJointCreateHinge (rob->w->world,0);
+    dJointDisable (robot_to_ball);
 
     rolling = 0;
     kicking = NO_KICK;
@@ -113,20 +165,23 @@ void Robot::Kicker::step()
     else box->setColor(0.9,0.9,0.9);
 }
 
-bool Robot::Kicker::isTouchingBall()
+void Robot::Kicker::updateBallProximity(const dReal* ball_pos)
 {
     dReal vx,vy,vz;
-    dReal bx,by,bz;
     dReal kx,ky,kz;
     rob->chassis->getBodyDirection(vx,vy,vz);
-    rob->getBall()->getBodyPosition(bx,by,bz);
     box->getBodyPosition(kx,ky,kz);
     kx += vx*rob->cfg->robotSettings.KickerThickness*0.5f;
     ky += vy*rob->cfg->robotSettings.KickerThickness*0.5f;
-    dReal xx = fabs((kx-bx)*vx + (ky-by)*vy);
-    dReal yy = fabs(-(kx-bx)*vy + (ky-by)*vx);
-    dReal zz = fabs(kz-bz);
-    return ((xx<rob->cfg->robotSettings.KickerThickness*2.0f+rob->cfg->BallRadius()) && (yy<rob->cfg->robotSettings.KickerWidth*0.5f) && (zz<rob->cfg->robotSettings.KickerHeight*0.5f));
+    ball_along = fabs((kx-ball_pos[0])*vx + (ky-ball_pos[1])*vy);
+    dReal yy = fabs(-(kx-ball_pos[0])*vy + (ky-ball_pos[1])*vx);
+    dReal zz = fabs(kz-ball_pos[2]);
+    touchingBall = (ball_along<rob->cfg->robotSettings.KickerThickness*2.0f+rob->cfg->BallRadius()) && (yy<rob->cfg->robotSettings.KickerWidth*0.5f) && (zz<rob->cfg->robotSettings.KickerHeight*0.5f);
+}
+
+bool Robot::Kicker::isTouchingBall()
+{
+    return touchingBall;
 }
 
 KickStatus Robot::Kicker::isKicking()
@@ -171,6 +226,7 @@ void Robot::Kicker::kick(dReal kickspeedx, dReal kickspeedz)
         vx += vn * dx - vt * dy;
         vy += vn * dy + vt * dx;
         dBodySetLinearVel(rob->getBall()->body,vx,vy,vz);
+        dBodyEnable(rob->getBall()->body);
         if (kickspeedz >= 1)
             kicking = CHIP_KICK;
         else
@@ -180,22 +236,12 @@ void Robot::Kicker::kick(dReal kickspeedx, dReal kickspeedz)
 }
 
 void Robot::Kicker::holdBall(){
-    dReal vx,vy,vz;
-    dReal bx,by,bz;
-    dReal kx,ky,kz;
-    rob->chassis->getBodyDirection(vx,vy,vz);
-    rob->getBall()->getBodyPosition(bx,by,bz);
-    box->getBodyPosition(kx,ky,kz);
-    kx += vx*rob->cfg->robotSettings.KickerThickness*0.5f;
-    ky += vy*rob->cfg->robotSettings.KickerThickness*0.5f;
-    dReal xx = fabs((kx-bx)*vx + (ky-by)*vy);
-    dReal yy = fabs(-(kx-bx)*vy + (ky-by)*vx);
-    if(holdingBall || xx-rob->cfg->BallRadius() < 0) return;
+    if(holdingBall || ball_along-rob->cfg->BallRadius() < 0) return;
     dBodySetLinearVel(rob->getBall()->body,0,0,0);
     if(!rob->getBall()->isDribbled()){
         rob->getBall()->setDribbled(true);
-        robot_to_ball = dJointCreateHinge(rob->getWorld()->world,0);
         dJointAttach (robot_to_ball,box->body,rob->getBall()->body);
+        dJointEnable (robot_to_ball);
         holdingBall = true;
     }
 }
@@ -203,12 +249,13 @@ void Robot::Kicker::holdBall(){
 void Robot::Kicker::unholdBall(){
     if(holdingBall) {
         rob->getBall()->setDribbled(false);
-        dJointDestroy(robot_to_ball);
+        dJointDisable(robot_to_ball);
+        dJointAttach(robot_to_ball,0,0);
         holdingBall = false;
     }
 }
 
-Robot::Robot(PWorld* world,PBall *ball,ConfigWidget* _cfg,dReal x,dReal y,dReal z,dReal r,dReal g,dReal b,int rob_id,int wheeltexid,int dir)
+Robot::Robot(PWorld* world,PBall *ball,ConfigWidget* _cfg,dReal x,dReal y,dReal z,dReal r,dReal g,dReal b,int rob_id,int wheeltexid,int dir,RobotModel model)
 {      
     m_r = r;
     m_g = g;
@@ -221,20 +268,30 @@ Robot::Robot(PWorld* world,PBall *ball,ConfigWidget* _cfg,dReal x,dReal y,dReal
     m_dir = dir;
     cfg = _cfg;
     m_rob_id = rob_id;
+    m_model = model;
 
     space = w->space;
 
-    chassis = new PCylinder(x,y,z,cfg->robotSettings.RobotRadius,cfg->robotSettings.RobotHeight,cfg->robotSettings.BodyMass*0.99f,r,g,b,rob_id,true);
+    m_limits.vx = m_limits.vy = cfg->robotSettings.MaxLinearSpeed;
+    m_limits.vw = cfg->robotSettings.MaxAngularSpeed;
+    m_limits.ax = m_limits.ay = cfg->robotSettings.MaxLinearAcceleration;
+    m_limits.aw = cfg->robotSettings.MaxAngularAcceleration;
+    m_kicker_reach = cfg->robotSettings.RobotCenterFromKicker + cfg->robotSettings.KickerThickness*1.5;
+    m_radius = cfg->robotSettings.RobotRadius;
+
+    dReal mass = cfg->robotSettings.BodyMass;
+    if (m_model == REDUCED_MODEL)
+        mass = cfg->robotSettings.BodyMass + cfg->robotSettings.KickerMass + 4*cfg->robotSettings.WheelMass;
+    chassis = new PCylinder(x,y,z,cfg->robotSettings.RobotRadius,cfg->robotSettings.RobotHeight,mass,r,g,b,rob_id,true);
     chassis->space = space;
     w->addObject(chassis);
+    if (m_model == KINEMATIC_MODEL) dBodySetKinematic(chassis->body);
 
-    dummy   = new PBall(x,y,z,cfg->robotSettings.RobotCenterFromKicker,cfg->robotSettings.BodyMass*0.01f,0,0,0);
-    dummy->setVisibility(false);
-    dummy->space = space;
-    w->addObject(dummy);
-
-    dummy_to_chassis = dJointCreateFixed(world->world,0);
-    dJointAttach (dummy_to_chassis,chassis->body,dummy->body);
+    hull = new PRobotHull(x,y,z,cfg->robotSettings.RobotRadius,cfg->robotSettings.RobotCenterFromKicker,cfg->robotSettings.RobotHeight,0);
+    hull->setKicker(cfg->robotSettings.KickerThickness*1.5f,cfg->robotSettings.KickerWidth); //front face of the kicker box
+    hull->space = space;
+    hull->setParent(chassis);
+    w->addObject(hull);
 
     kicker = new Kicker(this);
 
@@ -242,8 +299,111 @@ Robot::Robot(PWorld* world,PBall *ball,ConfigWidget* _cfg,dReal x,dReal y,dReal
     wheels[1] = new Wheel(this,1,cfg->robotSettings.Wheel2Angle,cfg->robotSettings.Wheel2Angle,wheeltexid);
     wheels[2] = new Wheel(this,2,cfg->robotSettings.Wheel3Angle,cfg->robotSettings.Wheel3Angle,wheeltexid);
     wheels[3] = new Wheel(this,3,cfg->robotSettings.Wheel4Angle,cfg->robotSettings.Wheel4Angle,wheeltexid);
+    drive = turn = 0;
+    m_last_delta_dir = 0;
+    initKinematics();
+    if (m_model == REDUCED_MODEL) initReducedDrive();
     firsttime=true;
     on = true;
+    last_state = true;
+}
+
+void Robot::initKinematics()
+{
+    // wheel speeds are w = M * (vx,vy,vw), commands are mapped back
+    // to a body velocity with the pseudo-inverse (M^T M)^-1 M^T
+    const dReal angles[4] = {cfg->robotSettings.Wheel1Angle,cfg->robotSettings.Wheel2Angle,cfg->robotSettings.Wheel3Angle,cfg->robotSettings.Wheel4Angle};
+    dReal (&M)[4][3] = m_wheels_from_body;
+    for (int i=0;i<4;i++)
+    {
+        const dReal a = angles[i]*M_PI/180.0;
+        M[i][0] = -sin(a) / cfg->robotSettings.WheelRadius;
+        M[i][1] =  cos(a) / cfg->robotSettings.WheelRadius;
+        M[i][2] = cfg->robotSettings.RobotRadius / cfg->robotSettings.WheelRadius;
+    }
+    dReal A[3][3];
+    for (int i=0;i<3;i++)
+        for (int j=0;j<3;j++)
+        {
+            A[i][j] = 0;
+            for (int k=0;k<4;k++) A[i][j] += M[k][i]*M[k][j];
+        }
+    const dReal det = A[0][0]*(A[1][1]*A[2][2]-A[1][2]*A[2][1])
+                    - A[0][1]*(A[1][0]*A[2][2]-A[1][2]*A[2][0])
+                    + A[0][2]*(A[1][0]*A[2][1]-A[1][1]*A[2][0]);
+    dReal Ainv[3][3];
+    for (int i=0;i<3;i++)
+        for (int j=0;j<3;j++)
+        {
+            // cofactor of A[j][i]
+            const int r0 = (j+1)%3,r1 = (j+2)%3,c0 = (i+1)%3,c1 = (i+2)%3;
+            Ainv[i][j] = (A[r0][c0]*A[r1][c1] - A[r0][c1]*A[r1][c0]) / det;
+        }
+    for (int i=0;i<3;i++)
+        for (int k=0;k<4;k++)
+        {
+            m_body_from_wheels[i][k] = 0;
+            for (int j=0;j<3;j++) m_body_from_wheels[i][k] += Ainv[i][j]*M[k][j];
+        }
+}
+
+void Robot::initReducedDrive()
+{
+    // the chassis floats at its start height. The motors hold z, roll and pitch
+    // with unbounded force and bound the acceleration of x, y and yaw
+    dMass m;
+    dBodyGetMass(chassis->body,&m);
+    dBodySetGravityMode(chassis->body,0);
+    drive = dJointCreateLMotor(w->world,0);
+    dJointAttach(drive,chassis->body,0);
+    dJointSetLMotorNumAxes(drive,3);
+    dJointSetLMotorAxis(drive,0,0,1,0,0);
+    dJointSetLMotorAxis(drive,1,0,0,1,0);
+    dJointSetLMotorAxis(drive,2,0,0,0,1);
+    dJointSetLMotorParam(drive,dParamFMax,m.mass*m_limits.ax);
+    dJointSetLMotorParam(drive,dParamFMax2,m.mass*m_limits.ax);
+    dJointSetLMotorParam(drive,dParamFMax3,dInfinity);
+    turn = dJointCreateAMotor(w->world,0);
+    dJointAttach(turn,chassis->body,0);
+    dJointSetAMotorMode(turn,dAMotorUser);
+    dJointSetAMotorNumAxes(turn,3);
+    dJointSetAMotorAxis(turn,0,0,1,0,0);
+    dJointSetAMotorAxis(turn,1,0,0,1,0);
+    dJointSetAMotorAxis(turn,2,0,0,0,1);
+    dJointSetAMotorParam(turn,dParamFMax,dInfinity);
+    dJointSetAMotorParam(turn,dParamFMax2,dInfinity);
+    dJointSetAMotorParam(turn,dParamFMax3,m.I[10]*m_limits.aw);
+}
+
+void Robot::stepDrive()
+{
+    if (m_model == KINEMATIC_MODEL) return;
+    for (auto & wheel : wheels)
+        if (wheel->speed != 0) {wake(); break;}
+    if (m_model == FULL_MODEL) return; //the motors run in stepMotors
+    dReal v[3] = {0,0,0};
+    for (int i=0;i<3;i++)
+        for (int k=0;k<4;k++)
+            v[i] += m_body_from_wheels[i][k]*wheels[k]->speed;
+    v[0] = std::max(-m_limits.vx,std::min(v[0],m_limits.vx));
+    v[1] = std::max(-m_limits.vy,std::min(v[1],m_limits.vy));
+    v[2] = std::max(-m_limits.vw,std::min(v[2],m_limits.vw));
+    dReal dx,dy,dz;
+    chassis->getBodyDirection(dx,dy,dz);
+    const dReal len = sqrt(dx*dx + dy*dy);
+    dx /= len;dy /= len;
+    // the motors constrain velocities only, the drift in height and tilt they
+    // leave behind is driven back to zero over the next frame
+    const dReal T = cfg->DeltaTime();
+    dReal x,y,z;
+    chassis->getBodyPosition(x,y,z);
+    const dReal* R = dBodyGetRotation(chassis->body);
+    dJointSetLMotorParam(drive,dParamVel,dx*v[0] - dy*v[1]);
+    dJointSetLMotorParam(drive,dParamVel2,dy*v[0] + dx*v[1]);
+    dJointSetLMotorParam(drive,dParamVel3,(m_z - z)/T);
+    dJointSetAMotorParam(turn,dParamVel,R[6]/T);
+    dJointSetAMotorParam(turn,dParamVel2,-R[2]/T);
+    dJointSetAMotorParam(turn,dParamVel3,v[2]);
 }
 
 Robot::~Robot()
@@ -266,6 +426,11 @@ int Robot::getID()
     return m_rob_id - 1;
 }
 
+RobotModel Robot::getModel()
+{
+    return m_model;
+}
+
 void normalizeVector(dReal& x,dReal& y,dReal& z)
 {
     dReal d = sqrt(x*x + y*y + z*z);
@@ -281,27 +446,79 @@ void Robot::step()
             if (m_dir==-1) setDir(180);
             firsttime = false;
         }
-        wheels[0]->step();
-        wheels[1]->step();
-        wheels[2]->step();
-        wheels[3]->step();
+        stepDrive();
         kicker->step();
     }
-    else {
-        if (last_state)
-        {
-            wheels[0]->speed = wheels[1]->speed = wheels[2]->speed = wheels[3]->speed = 0;
-            kicker->setRoller(0);
-            wheels[0]->step();
-            wheels[1]->step();
-            wheels[2]->step();
-            wheels[3]->step();
-            kicker->step();
-        }
+}
+
+void Robot::updateOnState()
+{
+    if (on == last_state) return;
+    if (!on)
+    {
+        wheels[0]->speed = wheels[1]->speed = wheels[2]->speed = wheels[3]->speed = 0;
+        kicker->setRoller(0);
+        stepDrive();
+        if (m_model == FULL_MODEL)
+            for (auto & wheel : wheels) wheel->step(0);
+        kicker->step();
+    }
+    // a switched off robot is neither collided nor stepped
+    PObject* parts[7] = {chassis,hull,kicker->box,wheels[0]->cyl,wheels[1]->cyl,wheels[2]->cyl,wheels[3]->cyl};
+    for (auto & part : parts)
+    {
+        if (on) dSpaceAdd(space,part->geom);
+        else dSpaceRemove(space,part->geom);
+        if (part->parent!=NULL) continue;
+        if (on) dBodyEnable(part->body);
+        else dBodyDisable(part->body);
     }
     last_state = on;
 }
 
+void Robot::stepMotors(dReal dt)
+{
+    if (!on || m_model == KINEMATIC_MODEL) return;
+    if (m_model == FULL_MODEL)
+    {
+        for (auto & wheel : wheels) wheel->step(dt);
+        return;
+    }
+    //without wheel joints the encoders follow the body velocity
+    const dReal* v = dBodyGetLinearVel(chassis->body);
+    const dReal* av = dBodyGetAngularVel(chassis->body);
+    dReal dx,dy,dz;
+    chassis->getBodyDirection(dx,dy,dz);
+    const dReal len = sqrt(dx*dx + dy*dy);
+    dx /= len;dy /= len;
+    const dReal body[3] = {dx*v[0] + dy*v[1],-dy*v[0] + dx*v[1],av[2]};
+    for (int i=0;i<4;i++)
+    {
+        wheels[i]->motor_speed = wheels[i]->speed;
+        wheels[i]->encoder += (m_wheels_from_body[i][0]*body[0] + m_wheels_from_body[i][1]*body[1] + m_wheels_from_body[i][2]*body[2])*dt;
+    }
+}
+
+void Robot::updateWheelDirs()
+{
+    //rolling direction of each wheel is its axis (local z) flattened onto the ground
+    for (int i=0;i<4;i++)
+    {
+        const dReal* r = dBodyGetRotation(wheels[i]->cyl->body);
+        const dReal l = sqrt(r[2]*r[2] + r[6]*r[6]);
+        wheelDirs[i][0] = r[2]/l;
+        wheelDirs[i][1] = r[6]/l;
+        wheelDirs[i][2] = 0;
+        wheelDirs[i][3] = 0;
+    }
+}
+
+void Robot::wake()
+{
+    // enabling the chassis enables everything jointed to it on the next step
+    if (on) dBodyEnable(chassis->body);
+}
+
 void Robot::drawLabel()
 {
     glPushMatrix();
@@ -359,20 +576,20 @@ void Robot::resetRobot()
     resetSpeeds();
     dBodySetLinearVel(chassis->body,0,0,0);
     dBodySetAngularVel(chassis->body,0,0,0);
-    dBodySetLinearVel(dummy->body,0,0,0);
-    dBodySetAngularVel(dummy->body,0,0,0);
     dBodySetLinearVel(kicker->box->body,0,0,0);
     dBodySetAngularVel(kicker->box->body,0,0,0);
     for (int i=0;i<4;i++)
     {
         dBodySetLinearVel(wheels[i]->cyl->body,0,0,0);
         dBodySetAngularVel(wheels[i]->cyl->body,0,0,0);
+        wheels[i]->motor_speed = wheels[i]->integral = wheels[i]->torque = 0;
     }
     dReal x,y;
     getXY(x,y);
     setXY(x,y);
     if (m_dir==-1) setDir(180);
     else setDir(0);
+    wake();
 }
 
 void Robot::getXY(dReal& x,dReal &y)
@@ -406,9 +623,14 @@ void Robot::setXY(dReal x,dReal y)
 {
     dReal xx,yy,zz,kx,ky,kz;
     dReal height = ROBOT_START_Z(cfg);
+    wake();
     chassis->getBodyPosition(xx,yy,zz);
+    if (m_model != FULL_MODEL)
+    {
+        chassis->setBodyPosition(x,y,m_z);
+        return;
+    }
     chassis->setBodyPosition(x,y,height);
-    dummy->setBodyPosition(x,y,height);
     kicker->box->getBodyPosition(kx,ky,kz);
     kicker->box->setBodyPosition(kx-xx+x,ky-yy+y,kz-zz+height);
     for (int i=0;i<4;i++)
@@ -421,9 +643,10 @@ void Robot::setXY(dReal x,dReal y)
 void Robot::setDir(dReal ang)
 {
     ang*=M_PI/180.0f;
+    wake();
     chassis->setBodyRotation(0,0,1,ang);
+    if (m_model != FULL_MODEL) return;
     kicker->box->setBodyRotation(0,0,1,ang);
-    dummy->setBodyRotation(0,0,1,ang);
     dMatrix3 wLocalRot,wRot,cRot;
     dVector3 localPos,finalPos,cPos;
     chassis->getBodyPosition(cPos[0],cPos[1],cPos[2],false);
@@ -445,13 +668,13 @@ void Robot::setDir(dReal ang)
 void Robot::setSpeed(int i,dReal s)
 {
     if (!((i>=4) || (i<0)))
+    {
         wheels[i]->speed = s;
+        if (s != 0) wake();
+    }
 }
 
 namespace{
-    static dReal delta_dir[24];
-    static dReal last_delta_dir[24];
-    static dReal diff_dir[24];
     dReal NormalizeDir(dReal angle) {
         const double M_2PI = M_PI * 2;
 
@@ -467,33 +690,88 @@ namespace{
 }
  
 
-void Robot::setSpeed(dReal vx, dReal vy, dReal vw, bool use_dir, int id)
+void Robot::addPoseSample(dReal t,dReal x,dReal y,dReal dir)
 {
-    // Calculate Motor Speeds
+    PoseSample sample = {t,x,y,dir};
+    int i = trajectory.count();
+    while (i > 0 && trajectory[i-1].t > t) i--;
+    trajectory.insert(i,sample);
+}
 
-    dReal _DEG2RAD = M_PI / 180.0;
+void Robot::followTrajectory(dReal t,dReal dt)
+{
+    // samples before the one at or just before t are not needed anymore
+    while (trajectory.count() > 1 && trajectory[1].t <= t) trajectory.removeFirst();
+    if (!on || trajectory.isEmpty() || trajectory[0].t > t || dt <= 0)
+    {
+        dBodySetLinearVel(chassis->body,0,0,0);
+        dBodySetAngularVel(chassis->body,0,0,0);
+        return;
+    }
+    PoseSample target = trajectory[0];
+    if (trajectory.count() > 1)
+    {
+        const PoseSample& next = trajectory[1];
+        const dReal a = (t - target.t) / (next.t - target.t);
+        const dReal turn = NormalizeDir((next.dir - target.dir)*M_PI/180.0)*180.0/M_PI;
+        target.x += (next.x - target.x)*a;
+        target.y += (next.y - target.y)*a;
+        target.dir += turn*a;
+    }
+    // the body is moved by its velocity, so contacts see the real motion
+    dReal x,y;
+    getXY(x,y);
+    const dReal turn = NormalizeDir(target.dir*M_PI/180.0 - getDir()*M_PI/180.0);
+    dBodySetLinearVel(chassis->body,(target.x - x)/dt,(target.y - y)/dt,0);
+    dBodySetAngularVel(chassis->body,0,0,turn/dt);
+    if (target.x != x || target.y != y || turn != 0) wake();
+}
+
+MotionLimits Robot::motionLimits()
+{
+    return m_limits;
+}
+
+dReal Robot::kickerReach()
+{
+    return m_kicker_reach;
+}
+
+dReal Robot::radius()
+{
+    return m_radius;
+}
+
+void Robot::stepOnboard(dReal t,dReal dt)
+{
+    if (!on || m_model == KINEMATIC_MODEL || controller.mode() == OnboardController::IDLE) return;
+    dReal x,y;
+    getXY(x,y);
+    const dReal dir = getDir()*M_PI/180.0;
+    const dReal* v = dBodyGetLinearVel(chassis->body);
+    const dReal* w = dBodyGetAngularVel(chassis->body);
+    const dReal pose[3] = {x,y,dir};
+    const dReal vel[3] = {v[0],v[1],w[2]};
+    dReal cmd[3];
+    controller.step(t,dt,pose,vel,cmd);
+    //the controller works in the field frame, wheels want the robot frame
+    const dReal c = cos(dir),s = sin(dir);
+    setSpeed(c*cmd[0] + s*cmd[1],-s*cmd[0] + c*cmd[1],cmd[2],false);
+    stepDrive();
+}
+
+void Robot::setSpeed(dReal vx, dReal vy, dReal vw, bool use_dir)
+{
     if(use_dir) {
-        dReal dir = vw;
-        delta_dir[id] = NormalizeDir(dir - getDir()/180.0f*M_PI);
-        diff_dir[id] = NormalizeDir(delta_dir[id] - last_delta_dir[id]);
-        last_delta_dir[id] = delta_dir[id];
-        if(abs(delta_dir[id]) < 0.01) delta_dir[id] = 0;
-        vw = 3.5*delta_dir[id] + 1.5*diff_dir[id];
-    } 
-    // if(id == 6) 
-    //     // std::cout<<" target angle: "<< vw << "state: " << getDir()/180.0f*M_PI << "vw: " << vw << "delta_dir" << delta_dir << "diff_dir" << diff_dir << std::endl;
-    //     std::cout<< " " << getDir()/180.0f*M_PI << " " << vw << " " << delta_dir << " " << diff_dir << std::endl;
-    dReal motorAlpha[4] = {cfg->robotSettings.Wheel1Angle * _DEG2RAD, cfg->robotSettings.Wheel2Angle * _DEG2RAD, cfg->robotSettings.Wheel3Angle * _DEG2RAD, cfg->robotSettings.Wheel4Angle * _DEG2RAD};
-
-    dReal dw1 =  (1.0 / cfg->robotSettings.WheelRadius) * (( (cfg->robotSettings.RobotRadius * vw) - (vx * sin(motorAlpha[0])) + (vy * cos(motorAlpha[0]))) );
-    dReal dw2 =  (1.0 / cfg->robotSettings.WheelRadius) * (( (cfg->robotSettings.RobotRadius * vw) - (vx * sin(motorAlpha[1])) + (vy * cos(motorAlpha[1]))) );
-    dReal dw3 =  (1.0 / cfg->robotSettings.WheelRadius) * (( (cfg->robotSettings.RobotRadius * vw) - (vx * sin(motorAlpha[2])) + (vy * cos(motorAlpha[2]))) );
-    dReal dw4 =  (1.0 / cfg->robotSettings.WheelRadius) * (( (cfg->robotSettings.RobotRadius * vw) - (vx * sin(motorAlpha[3])) + (vy * cos(motorAlpha[3]))) );
-
-    setSpeed(0 , dw1);
-    setSpeed(1 , dw2);
-    setSpeed(2 , dw3);
-    setSpeed(3 , dw4);
+        dReal delta_dir = NormalizeDir(vw - getDir()/180.0f*M_PI);
+        dReal diff_dir = NormalizeDir(delta_dir - m_last_delta_dir);
+        m_last_delta_dir = delta_dir;
+        if(fabs(delta_dir) < 0.01) delta_dir = 0;
+        vw = 3.5*delta_dir + 1.5*diff_dir;
+    }
+    // Calculate Motor Speeds, setSpeed wakes the robot
+    for (int i=0;i<4;i++)
+        setSpeed(i, m_wheels_from_body[i][0]*vx + m_wheels_from_body[i][1]*vy + m_wheels_from_body[i][2]*vw);
 }
 
 
@@ -506,6 +784,9 @@ dReal Robot::getSpeed(int i)
 void Robot::incSpeed(int i,dReal v)
 {
     if (!((i>=4) || (i<0)))
+    {
         wheels[i]->speed += v;
+        if (v != 0) wake();
+    }
 }
 
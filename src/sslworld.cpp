@@ -24,12 +24,17 @@ Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
 #include <QDebug>
 #include <thread>
 #include <chrono>
+#include <algorithm>
 
 #include "logger.h"
+#include "physics/psweep.h"
+#include "physics/pballmodel.h"
 
 #include "grSim_Packet.pb.h"
 #include "grSim_Commands.pb.h"
 #include "grSim_Replacement.pb.h"
+#include "grSim_BallPrediction.pb.h"
+#include "grSim_GameEvent.pb.h"
 #include "messages_robocup_ssl_detection.pb.h"
 #include "messages_robocup_ssl_geometry.pb.h"
 #include "messages_robocup_ssl_refbox_log.pb.h"
@@ -38,8 +43,14 @@ Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
 
 #define ROBOT_GRAY 0.4
 #define WHEEL_COUNT 4
+#define BLOB_COUNT 16 //robot color patterns in textures.qrc
+#define FORMATION_TABLE_SIZE 16
+
+// PWorld object groups of the robot parts that collide with other robots
+#define ROBOT_HULLS 0
+#define ROBOT_CHASSIS 1
+#define ROBOT_KICKERS 2
 
-SSLWorld* _w;
 dReal randn_notrig(dReal mu=0.0, dReal sigma=1.0);
 dReal randn_trig(dReal mu=0.0, dReal sigma=1.0);
 dReal rand0_1();
@@ -51,49 +62,27 @@ dReal fric(dReal f)
     return f;
 }
 
-bool wheelCallBack(dGeomID o1,dGeomID o2,PSurface* s, int /*robots_count*/)
+bool wheelCallBack(dGeomID /*o1*/,dGeomID /*o2*/,PSurface* s, int /*robots_count*/)
 {
-    //s->id2 is ground
-    const dReal* r; //wheels rotation matrix
-    //const dReal* p; //wheels rotation matrix
-    if ((o1==s->id1) && (o2==s->id2)) {
-        r=dBodyGetRotation(dGeomGetBody(o1));
-        //p=dGeomGetPosition(o1);//never read
-    } else if ((o1==s->id2) && (o2==s->id1)) {
-        r=dBodyGetRotation(dGeomGetBody(o2));
-        //p=dGeomGetPosition(o2);//never read
-    } else {
-        //XXX: in this case we dont have the rotation
-        //     matrix, thus we must return
-        return false;
-    }
-
-    s->surface.mode = dContactFDir1 | dContactMu2  | dContactApprox1 | dContactSoftCFM;
-    s->surface.mu = fric(_w->cfg->robotSettings.WheelPerpendicularFriction);
-    s->surface.mu2 = fric(_w->cfg->robotSettings.WheelTangentFriction);
-    s->surface.soft_cfm = 0.002;
-
-    dVector3 v={0,0,1,1};
-    dVector3 axis;
-    dMultiply0(axis,r,v,4,3,1);
-    dReal l = sqrt(axis[0]*axis[0] + axis[1]*axis[1]);
-    s->fdir1[0] = axis[0]/l;
-    s->fdir1[1] = axis[1]/l;
-    s->fdir1[2] = 0;
-    s->fdir1[3] = 0;
-    s->usefdir1 = true;
+    //s->data is the wheel's entry in Robot::wheelDirs, filled before the substep
+    const dReal* dir = (const dReal*)s->data;
+    s->fdir1[0] = dir[0];
+    s->fdir1[1] = dir[1];
+    s->fdir1[2] = dir[2];
+    s->fdir1[3] = dir[3];
     return true;
 }
 
 bool rayCallback(dGeomID o1,dGeomID o2,PSurface* s, int robots_count)
 {
+    SSLWorld* _w = (SSLWorld*)s->data;
     if (!_w->updatedCursor) return false;
     dGeomID obj;
     if (o1==_w->ray->geom) obj = o2;
     else obj = o1;
     for (int i=0;i<robots_count * 2;i++)
     {
-        if (_w->robots[i]->chassis->geom==obj || _w->robots[i]->dummy->geom==obj)
+        if (_w->robots[i]->chassis->geom==obj)
         {
             _w->robots[i]->selected = true;
             _w->robots[i]->select_x = s->contactPos[0];
@@ -114,8 +103,12 @@ bool rayCallback(dGeomID o1,dGeomID o2,PSurface* s, int robots_count)
     return false;
 }
 
-bool ballCallBack(dGeomID o1,dGeomID o2,PSurface* s, int /*robots_count*/)
+bool ballCallBack(dGeomID /*o1*/,dGeomID /*o2*/,PSurface* s, int /*robots_count*/)
 {
+    SSLWorld* _w = (SSLWorld*)s->data;
+    if (_w->ballAnalytic) return false; //the ground is part of the analytic model
+    s->surface = _w->ballGroundSurface;
+    s->usefdir1 = false;
     if (_w->ball->tag!=-1) //spinner adjusting
     {
         dReal x,y,z;
@@ -133,22 +126,46 @@ bool ballCallBack(dGeomID o1,dGeomID o2,PSurface* s, int /*robots_count*/)
     return true;
 }
 
+bool ballRobotCallBack(dGeomID o1,dGeomID o2,PSurface* s, int /*robots_count*/)
+{
+    //the hull tells whether the ball hit the kicker face or the body
+    SSLWorld* _w = (SSLWorld*)s->data;
+    dGeomID hull = (o1==_w->ball->geom) ? o2 : o1;
+    s->surface = dGeomRobotHullOnKicker(hull,s->contactPos) ? _w->ballKickerSurface : _w->ballRobotSurface;
+    for (int k=0;k<_w->robots.size();k++)
+        if (_w->robots[k]->hull->geom == hull) _w->gameEvents->touch(k);
+    return true;
+}
+
 SSLWorld::SSLWorld(QGLWidget* parent,ConfigWidget* _cfg,RobotsFomation *form1,RobotsFomation *form2)
     : QObject(parent)
 {    
     isGLEnabled = true;
     customDT = -1;    
-    _w = this;
     cfg = _cfg;
     m_parent = parent;
     show3DCursor = false;
     updatedCursor = false;
     framenum = 0;
     last_dt = -1;    
+    substeps = 0;
+    ballAnalytic = false;
+    simTime = 0;
+    sendHead = sendCount = 0;
+    forms[0] = form1;
+    forms[1] = form2;
+    refereeRestart = -1;
+    refereeKickoff = false;
     g = new CGraphics(parent);
     g->setSphereQuality(1);
     g->setViewpoint(0,-(cfg->Field_Width()+cfg->Field_Margin()*2.0f)/2.0f,3,90,-45,0);
-    p = new PWorld(0.05,9.81f,g,cfg->Robots_Count());
+    p = new PWorld(0.05,9.81f,g,cfg->Robots_Count(),cfg->PhysicsThreads());
+    if (cfg->PhysicsThreads() > 0 && p->threadCount() == 0)
+        logStatus("ODE threading is not available, stepping islands on a single thread",QColor("orange"));
+    // the check steps twice from one state, the auto-disable timers would
+    // advance twice and put bodies to sleep in one run only
+    p->setDeterminismCheck(cfg->PhysicsThreadsCheck());
+    p->setAutoDisable(cfg->AutoDisable() && !cfg->PhysicsThreadsCheck());
     ball = new PBall (0,0,0.5,cfg->BallRadius(),cfg->BallMass(), 1,0.7,0);
 
     ground = new PGround(cfg->Field_Rad(),cfg->Field_Length(),cfg->Field_Width(),cfg->Field_Penalty_Depth(),cfg->Field_Penalty_Width(),cfg->Field_Penalty_Point(),cfg->Field_Line_Width(),0);
@@ -224,6 +241,7 @@ SSLWorld::SSLWorld(QGLWidget* parent,ConfigWidget* _cfg,RobotsFomation *form1,Ro
     const int wheeltexid = 4 * cfg->Robots_Count() + 12 + 1 ; //37 for 6 robots
 
 
+    robots.resize(cfg->Robots_Count()*2);
     cfg->robotSettings = cfg->blueSettings;
     for (int k=0;k<cfg->Robots_Count();k++) {
         float a1 = -form1->x[k];
@@ -240,22 +258,28 @@ SSLWorld::SSLWorld(QGLWidget* parent,ConfigWidget* _cfg,RobotsFomation *form1,Ro
                               ROBOT_GRAY,
                               k + 1,
                               wheeltexid,
-                              1);
+                              1,
+                              robotModel(cfg->BlueRobotModel()));
     }
     cfg->robotSettings = cfg->yellowSettings;
     for (int k=0;k<cfg->Robots_Count();k++)
-        robots[k+cfg->Robots_Count()] = new Robot(p,ball,cfg,form2->x[k],form2->y[k],ROBOT_START_Z(cfg),ROBOT_GRAY,ROBOT_GRAY,ROBOT_GRAY,k+cfg->Robots_Count()+1,wheeltexid,-1);//XXX
+        robots[k+cfg->Robots_Count()] = new Robot(p,ball,cfg,form2->x[k],form2->y[k],ROBOT_START_Z(cfg),ROBOT_GRAY,ROBOT_GRAY,ROBOT_GRAY,k+cfg->Robots_Count()+1,wheeltexid,-1,robotModel(cfg->YellowRobotModel()));//XXX
 
     p->initAllObjects();
 
     //Surfaces
 
-    p->createSurface(ray,ground)->callback = rayCallback;
-    p->createSurface(ray,ball)->callback = rayCallback;
+    PSurface* ray_ground = p->createSurface(ray,ground,"ray");
+    ray_ground->callback = rayCallback;
+    ray_ground->data = this;
+    PSurface* ray_ball = p->createSurface(ray,ball,"ray");
+    ray_ball->callback = rayCallback;
+    ray_ball->data = this;
     for (int k=0;k<cfg->Robots_Count() * 2;k++)
     {
-        p->createSurface(ray,robots[k]->chassis)->callback = rayCallback;
-        p->createSurface(ray,robots[k]->dummy)->callback = rayCallback;
+        PSurface* ray_robot = p->createSurface(ray,robots[k]->chassis,"ray");
+        ray_robot->callback = rayCallback;
+        ray_robot->data = this;
     }
     PSurface ballwithwall;
     ballwithwall.surface.mode = dContactBounce | dContactApprox1;// | dContactSlip1;
@@ -264,56 +288,105 @@ SSLWorld::SSLWorld(QGLWidget* parent,ConfigWidget* _cfg,RobotsFomation *form1,Ro
     ballwithwall.surface.bounce_vel = cfg->BallBounceVel();
     ballwithwall.surface.slip1 = 0;//cfg->ballslip();
 
-    PSurface wheelswithground;
-    PSurface* ball_ground = p->createSurface(ball,ground);
-    ball_ground->surface = ballwithwall.surface;
+    PSurface* ball_ground = p->createSurface(ball,ground,"ball-ground");
+    ballGroundSurface = ballwithwall.surface;
+    ballGroundSurface.mu = cfg->BallSlideFriction(); //the sliding phase of PBallModel
+    ball_ground->surface = ballGroundSurface;
     ball_ground->callback = ballCallBack;
+    ball_ground->data = this;
 
-    PSurface ballwithkicker;
-    ballwithkicker.surface.mode = dContactApprox1;
-    ballwithkicker.surface.mu = fric(cfg->robotSettings.Kicker_Friction);
-    ballwithkicker.surface.slip1 = 5;
+    PSurface ballwithrobot;
+    ballRobotSurface = ballwithrobot.surface;
+    ballKickerSurface.mode = dContactApprox1;
+    ballKickerSurface.mu = fric(cfg->robotSettings.Kicker_Friction);
+    ballKickerSurface.slip1 = 5;
     
-    for (auto & wall : walls) p->createSurface(ball, wall)->surface = ballwithwall.surface;
+    for (auto & wall : walls) p->createSurface(ball,wall,"ball-wall")->surface = ballwithwall.surface;
     
     for (int k = 0; k < 2 * cfg->Robots_Count(); k++)
     {
-        p->createSurface(robots[k]->chassis,ground);
-        for (auto & wall : walls) p->createSurface(robots[k]->chassis,wall);
-        p->createSurface(robots[k]->dummy,ball);
-        //p->createSurface(robots[k]->chassis,ball);
-        p->createSurface(robots[k]->kicker->box,ball)->surface = ballwithkicker.surface;
-        for (auto & wheel : robots[k]->wheels)
+        // the reduced model floats above the ground, kinematic robots only push others
+        const bool grounded = robots[k]->getModel() == FULL_MODEL;
+        if (grounded) p->createSurface(robots[k]->chassis,ground,"chassis-ground");
+        if (robots[k]->getModel() != KINEMATIC_MODEL)
+            for (auto & wall : walls) p->createSurface(robots[k]->chassis,wall,"robot-wall");
+        //the hull covers chassis, wheels and kicker face for the ball
+        PSurface* ball_robot = p->createSurface(robots[k]->hull,ball,"ball-robot");
+        ball_robot->callback = ballRobotCallBack;
+        ball_robot->data = this;
+        const RobotSettings& team = (k < cfg->Robots_Count()) ? cfg->blueSettings : cfg->yellowSettings;
+        if (grounded)
+        for (int i=0;i<WHEEL_COUNT;i++)
         {
-            p->createSurface(wheel->cyl,ball);
-            PSurface* w_g = p->createSurface(wheel->cyl,ground);
-            w_g->surface=wheelswithground.surface;
+            PSurface* w_g = p->createSurface(robots[k]->wheels[i]->cyl,ground,"wheel-ground");
+            w_g->surface.mode = dContactFDir1 | dContactMu2  | dContactApprox1 | dContactSoftCFM;
+            w_g->surface.mu = fric(team.WheelPerpendicularFriction);
+            w_g->surface.mu2 = fric(team.WheelTangentFriction);
+            w_g->surface.soft_cfm = 0.002;
             w_g->usefdir1=true;
             w_g->callback=wheelCallBack;
+            w_g->data = robots[k]->wheelDirs[i];
         }
-        for (int j = k + 1; j < 2 * cfg->Robots_Count(); j++)
-        {            
-            if (k != j)
-            {
-                p->createSurface(robots[k]->dummy,robots[j]->dummy); //seams ode doesn't understand cylinder-cylinder contacts, so I used spheres
-                p->createSurface(robots[k]->chassis,robots[j]->kicker->box);
-            }
-        }
+        p->setGroup(robots[k]->hull,ROBOT_HULLS);
+        p->setGroup(robots[k]->chassis,ROBOT_CHASSIS);
+        p->setGroup(robots[k]->kicker->box,ROBOT_KICKERS);
     }
+    // shared by all robot pairs, the parts of one robot are joined and skipped
+    p->createGroupSurface(ROBOT_HULLS,ROBOT_HULLS,"robot-robot"); //ode doesn't understand cylinder-cylinder contacts
+    p->createGroupSurface(ROBOT_CHASSIS,ROBOT_KICKERS,"robot-kicker");
+    if (!cfg->CollisionStatsFile().empty() && !p->collisionStats.setCsvFile(cfg->CollisionStatsFile().c_str()))
+        logStatus(QString("Could not open collision statistics file %1").arg(cfg->CollisionStatsFile().c_str()),QColor("red"));
+    if (!cfg->KinematicTrajectoryFile().empty())
+        loadTrajectories(cfg->KinematicTrajectoryFile().c_str());
     sendGeomCount = 0;
     timer = new QTime();
     timer->start();
     in_buffer = new char [65536];
 
     // initialize robot state
-    for (int team = 0; team < 2; ++team)
+    for (int team = 0; team < TEAM_COUNT; ++team)
     {
-        for (int i = 0; i < MAX_ROBOT_COUNT; ++i)
-        {
-            lastInfraredState[team][i] = false;
-            lastKickState[team][i] = NO_KICK; 
-        }
+        lastInfraredState[team].fill(false, cfg->Robots_Count());
+        lastKickState[team].fill(NO_KICK, cfg->Robots_Count());
     }
+    gameEvents = new GameEventDetector(cfg,cfg->Robots_Count()*2);
+    watchdog = new WorldWatchdog(cfg,cfg->Robots_Count()*2);
+    stepErrors = 0;
+    determinismMismatches = 0;
+    eventSocket = new QUdpSocket(this);
+}
+
+RobotModel robotModel(const std::string& name)
+{
+    if (name == "Reduced") return REDUCED_MODEL;
+    if (name == "Kinematic") return KINEMATIC_MODEL;
+    return FULL_MODEL;
+}
+
+void SSLWorld::loadTrajectories(const QString& filename)
+{
+    // one sample per line: t,team,id,x,y,dir with team 0 for blue and 1 for yellow
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        logStatus(QString("Could not open trajectory file %1").arg(filename),QColor("red"));
+        return;
+    }
+    QTextStream in(&file);
+    int count = 0;
+    while (!in.atEnd()) {
+        QString line = in.readLine();
+        QStringList list = line.split(",");
+        if (list.count() < 6) continue;
+        bool ok;
+        dReal t = list[0].toDouble(&ok);
+        if (!ok) continue; //header or comment
+        int id = robotIndex(list[2].toInt(),list[1].toInt());
+        if (id < 0 || robots[id]->getModel() != KINEMATIC_MODEL) continue;
+        robots[id]->addPoseSample(t,list[3].toDouble(),list[4].toDouble(),list[5].toDouble());
+        count++;
+    }
+    logStatus(QString("Loaded %1 pose samples from %2").arg(count).arg(filename),QColor("green"));
 }
 
 int SSLWorld::robotIndex(int robot,int team)
@@ -324,13 +397,17 @@ int SSLWorld::robotIndex(int robot,int team)
 
 SSLWorld::~SSLWorld()
 {
+    for (SendingPacket* s : sendRing) delete s;
+    delete gameEvents;
+    delete watchdog;
     delete g;
     delete p;
 }
 
 QImage* createBlob(char yb,int i,QImage** res)
 {
-    *res = new QImage(QString(":/%1%2").arg(yb).arg(i)+QString(".png"));
+    //only 16 color patterns are shipped, larger teams reuse them
+    *res = new QImage(QString(":/%1%2").arg(yb).arg(i % BLOB_COUNT)+QString(".png"));
     return *res;
 }
 
@@ -405,31 +482,113 @@ void SSLWorld::step(dReal dt)
     if (customDT > 0) dt = customDT;
     const auto ratio = m_parent->devicePixelRatio();
     g->initScene(m_parent->width()*ratio,m_parent->height()*ratio,0,0.7,1);
-    int ballCollisionTry = 4;
-    for (int kk=0;kk < ballCollisionTry;kk++) {
+    if (dt == 0) dt = last_dt;
+    else last_dt = dt;
+    for (int k=0;k<cfg->Robots_Count() * 2;k++)
+        robots[k]->updateOnState();
+    substeps = substepCount(dt);
+    dReal ball_pos[3],ball_vel[3],ball_angvel[3];
+    ballAnalytic = cfg->BallAnalytic() && ballIsFree(dt);
+    if (ballAnalytic)
+    {
+        // the ball is moved along the closed form solution as a kinematic body,
+        // its average velocity over the frame makes ODE end up at the same place
+        PBallModel model = ballModel(dt/substeps);
+        const dReal* pos = dBodyGetPosition(ball->body);
+        const dReal* vel = dBodyGetLinearVel(ball->body);
+        const dReal* angvel = dBodyGetAngularVel(ball->body);
+        for (int i=0;i<3;i++)
+        {
+            ball_pos[i] = pos[i];
+            ball_vel[i] = vel[i];
+            ball_angvel[i] = angvel[i];
+        }
+        ball_vel[2] = 0;
+        model.step(ball_pos,ball_vel,ball_angvel,dt);
+        dBodySetKinematic(ball->body);
+        if (ball_pos[0] != pos[0] || ball_pos[1] != pos[1]) dBodyEnable(ball->body);
+        dBodySetLinearVel(ball->body,(ball_pos[0]-pos[0])/dt,(ball_pos[1]-pos[1])/dt,0);
+        dBodySetAngularVel(ball->body,ball_angvel[0],ball_angvel[1],ball_angvel[2]);
+    }
+    else if (dBodyIsKinematic(ball->body))
+    {
+        dBodySetDynamic(ball->body);
+        dBodyEnable(ball->body);
+    }
+    for (int k=0;k<cfg->Robots_Count() * 2;k++)
+        if (robots[k]->getModel() == KINEMATIC_MODEL) robots[k]->followTrajectory(simTime + dt,dt);
+    for (int kk=0;kk < substeps;kk++) {
         const dReal* ballvel = dBodyGetLinearVel(ball->body);
-        dReal ballspeed = ballvel[0]*ballvel[0] + ballvel[1]*ballvel[1] + ballvel[2]*ballvel[2];
+        const dReal* ballangvel = dBodyGetAngularVel(ball->body);
+        const dReal ballr = cfg->BallRadius();
+        dReal ballspeed = ballvel[0]*ballvel[0] + ballvel[1]*ballvel[1];
         ballspeed = sqrt(ballspeed);
+        // rolling resistance only while the ball rolls on the ground, a sliding
+        // ball only has the contact friction (the two phases of PBallModel)
+        const dReal slipx = ballvel[0] - ballr*ballangvel[1];
+        const dReal slipy = ballvel[1] + ballr*ballangvel[0];
+        const bool rolling = dBodyGetPosition(ball->body)[2] <= ballr*1.1 && slipx*slipx + slipy*slipy < 1e-4;
         dReal ballfx=0,ballfy=0,ballfz=0;
         dReal balltx=0,ballty=0,balltz=0;
-        if (ballspeed > 0.01) {
+        if (ballspeed > 0.01 && rolling && !ballAnalytic) {
             dReal fk = cfg->BallFriction()*cfg->BallMass()*cfg->Gravity();
             ballfx = -fk*ballvel[0] / ballspeed;
             ballfy = -fk*ballvel[1] / ballspeed;
-            ballfz = -fk*ballvel[2] / ballspeed;
-            balltx = -ballfy*cfg->BallRadius();
-            ballty = ballfx*cfg->BallRadius();
-            balltz = 0;
+            balltx = -ballfy*ballr;
+            ballty = ballfx*ballr;
             dBodyAddTorque(ball->body,balltx,ballty,balltz);
         }
         dBodyAddForce(ball->body,ballfx,ballfy,ballfz);
-        if (dt == 0) dt = last_dt;
-        else last_dt = dt;
+
+        for (int k=0;k<cfg->Robots_Count() * 2;k++)
+            if (robots[k]->on && robots[k]->getModel() == FULL_MODEL) robots[k]->updateWheelDirs();
 
         selected = -1;
-        p->step(dt/ballCollisionTry);
+        const dReal h = dt/substeps;
+        for (int k=0;k<cfg->Robots_Count() * 2;k++)
+        {
+            robots[k]->stepOnboard(simTime + kk*h,h);
+            robots[k]->stepMotors(h);
+        }
+        const dReal* bp = dBodyGetPosition(ball->body);
+        const dReal ball_from[3] = {bp[0],bp[1],bp[2]};
+        dReal travel = 0;
+        const dReal toi = (cfg->BallCCD() && !ballAnalytic) ? ballTimeOfImpact(h,&travel) : -1;
+        // a ball already in contact (dribbled or pressed against a robot) gets
+        // its contact from the full step, splitting would only cost a step
+        if (toi > 0)
+        {
+            // stop the substep just after the ball meets its obstacle so the
+            // contact is generated before the ball can pass through it,
+            // travel is measured relative to that obstacle like toi
+            const dReal t = std::min(toi + 0.5*cfg->BallRadius()/travel, (dReal)1);
+            p->step(h*t);
+            if (t < 1)
+            {
+                // the world step cleared the accumulated ball friction
+                dBodyAddTorque(ball->body,balltx,ballty,balltz);
+                dBodyAddForce(ball->body,ballfx,ballfy,ballfz);
+                p->step(h*(1-t));
+            }
+        }
+        else p->step(h);
+        gameEvents->update(simTime + kk*h,simTime + (kk+1)*h,ball_from,dBodyGetPosition(ball->body),
+                           dBodyGetLinearVel(ball->body),robots);
     }
-
+    p->endFrame();
+    if (ballAnalytic)
+    {
+        dBodySetPosition(ball->body,ball_pos[0],ball_pos[1],ball_pos[2]);
+        dBodySetLinearVel(ball->body,ball_vel[0],ball_vel[1],0);
+    }
+    simTime += dt;
+    // turned over robots are put back by the watchdog, the vision output only reads the result
+    checkHealth();
+    updateBallProximity();
+    const QVector<GameEvent> events = gameEvents->takeEvents();
+    publishGameEvents(events);
+    if (cfg->AutoReferee()) stepReferee(events);
+    else refereeRestart = -1;
 
     int best_k=-1;
     dReal best_dist = 1e8;
@@ -519,14 +678,187 @@ void SSLWorld::step(dReal dt)
     ballvel_last[0] = ballvel[0];
     ballvel_last[1] = ballvel[1];
     ballvel_last[2] = ballvel[2];
+    takeVisionSnapshot();
     sendVisionBuffer();
     framenum ++;
 }
 
+void SSLWorld::takeVisionSnapshot()
+{
+    VisionSnapshot& s = visionSnapshot;
+    s.frame = framenum;
+    ball->getBodyPosition(s.ball[0],s.ball[1],s.ball[2]);
+    s.robots.resize(cfg->Robots_Count()*2);
+    for (int k=0;k<cfg->Robots_Count()*2;k++)
+    {
+        VisionSnapshot::RobotState& r = s.robots[k];
+        r.on = robots[k]->on;
+        robots[k]->getXY(r.x,r.y);
+        r.dir = r.on ? robots[k]->getDir() : 0;
+    }
+}
+
+MotionLimits SSLWorld::commandLimits(int id,const ZSS::New::CmdPose& pose)
+{
+    MotionLimits l = robots[id]->motionLimits();
+    if (!pose.use_config()) return l;
+    const ZSS::New::CmdPoseConfig& c = pose.config();
+    l.vx = c.max_vx();
+    l.vy = c.max_vy();
+    l.vw = c.max_vw();
+    l.ax = c.max_ax();
+    l.ay = c.max_ay();
+    l.aw = c.max_aw();
+    return l;
+}
+
+void SSLWorld::updateBallProximity()
+{
+    //one pass over all kickers after the physics step, the kicker step,
+    //kick commands and the status replies all read the result
+    const dReal* ball_pos = dBodyGetPosition(ball->body);
+    for (int k=0;k<cfg->Robots_Count() * 2;k++)
+        robots[k]->kicker->updateBallProximity(ball_pos);
+}
+
+int SSLWorld::substepCount(dReal dt)
+{
+    // a body must not move further than its critical length in one substep:
+    // for the ball that is the point where its center passes the middle of the
+    // thinnest obstacle (goal wall or kicker plate), for robots their radius.
+    // the ball is left out when it is guarded by ballTimeOfImpact().
+    // MinSubsteps keeps the joint and contact resolution of the old fixed
+    // four substeps, only fast frames get more
+    const dReal thinnest = std::min({cfg->Goal_Thickness(),
+                                     cfg->blueSettings.KickerThickness,
+                                     cfg->yellowSettings.KickerThickness});
+    dReal ratio = 0;
+    if (!cfg->BallCCD())
+    {
+        const dReal* ballvel = dBodyGetLinearVel(ball->body);
+        dReal ballspeed = sqrt(ballvel[0]*ballvel[0] + ballvel[1]*ballvel[1] + ballvel[2]*ballvel[2]);
+        ratio = ballspeed / (cfg->BallRadius() + thinnest*0.5);
+    }
+    for (int k=0;k<cfg->Robots_Count() * 2;k++)
+    {
+        if (!robots[k]->on) continue;
+        const dReal* v = dBodyGetLinearVel(robots[k]->chassis->body);
+        const dReal* w = dBodyGetAngularVel(robots[k]->chassis->body);
+        const dReal radius = robots[k]->radius();
+        dReal speed = sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]) + fabs(w[2])*radius;
+        ratio = std::max(ratio, speed / radius);
+    }
+    int n = (int)ceil(ratio*dt);
+    n = std::min(n, cfg->MaxSubsteps());
+    return std::max(std::max(n, cfg->MinSubsteps()), 1);
+}
+
+bool SSLWorld::ballIsFree(dReal dt)
+{
+    if (ball->isDribbled()) return false;
+    const dReal* pos = dBodyGetPosition(ball->body);
+    const dReal* vel = dBodyGetLinearVel(ball->body);
+    const dReal r = cfg->BallRadius();
+    // on the ground and staying there
+    if (pos[2] > r*1.1 || fabs(vel[2]) > 0.05) return false;
+    // nothing within reach of the ball during this frame. The kinematic ball
+    // would be an immovable obstacle, so a robot is kept clear by the whole
+    // distance it can cover in a frame whatever it is commanded, with some room
+    // left for the robots speeding up
+    const dReal margin = 0.02;
+    const dReal d[3] = {vel[0]*dt,vel[1]*dt,0};
+    for (int i=0;i<WALL_COUNT;i++)
+        if (sweepSphereGeom(pos,d,r + margin,walls[i]->geom) >= 0) return false;
+    for (int k=0;k<cfg->Robots_Count() * 2;k++)
+    {
+        if (!robots[k]->on) continue;
+        if (robots[k]->kicker->holdingBall) return false;
+        const dReal* v = dBodyGetLinearVel(robots[k]->chassis->body);
+        const dReal* w = dBodyGetAngularVel(robots[k]->chassis->body);
+        const dReal speed = std::max(sqrt(v[0]*v[0] + v[1]*v[1]),robots[k]->motionLimits().vx) + fabs(w[2])*robots[k]->kickerReach();
+        if (sweepSphereGeom(pos,d,r + margin + speed*dt,robots[k]->hull->geom) >= 0) return false;
+    }
+    return true;
+}
+
+PBallModel SSLWorld::ballModel(dReal h)
+{
+    // ODE damps the ball by a fixed fraction per step, as a rate that depends
+    // on the substep length
+    auto rate = [h](dReal d) {return (d > 0) ? -log(1 - std::min(d,(dReal)0.999))/h : 0;};
+    const dReal kl = rate(dBodyGetLinearDamping(ball->body));
+    const dReal ka = rate(dBodyGetAngularDamping(ball->body));
+    // the rolling resistance of step() acts like a force at the top of the
+    // ball, which slows a rolling solid sphere down by 10/7 of it. The rolling
+    // phase decays at the mass weighted mix of both damping rates (exact while
+    // they are equal, which is the default)
+    return PBallModel(cfg->BallRadius(),cfg->BallSlideFriction(),cfg->BallFriction()*10/7,cfg->Gravity(),(5*kl + 2*ka)/7);
+}
+
+dReal SSLWorld::ballTimeOfImpact(dReal h,dReal* travel)
+{
+    const dReal* pos = dBodyGetPosition(ball->body);
+    const dReal* vel = dBodyGetLinearVel(ball->body);
+    const dReal r = cfg->BallRadius();
+    // nothing can be skipped while the ball moves less than its radius
+    if ((vel[0]*vel[0] + vel[1]*vel[1] + vel[2]*vel[2])*h*h < r*r) return -1;
+    dReal best = -1;
+    bool touching = false;
+    auto sweep = [&](dGeomID geom,const dReal* v) {
+        const dReal d[3] = {(vel[0]-v[0])*h,(vel[1]-v[1])*h,(vel[2]-v[2])*h};
+        dReal t = sweepSphereGeom(pos,d,r,geom);
+        // overlapping shapes are already in contact, ODE takes care of them
+        touching |= (t == 0);
+        if (t > 0 && (best < 0 || t < best))
+        {
+            best = t;
+            if (travel) *travel = sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+        }
+    };
+    const dReal still[3] = {0,0,0};
+    for (int i=0;i<WALL_COUNT;i++)
+        sweep(walls[i]->geom,still);
+    for (int k=0;k<cfg->Robots_Count() * 2;k++)
+    {
+        if (!robots[k]->on) continue;
+        sweep(robots[k]->hull->geom,dBodyGetLinearVel(robots[k]->chassis->body));
+    }
+    return touching ? 0 : best;
+}
+
+void SSLWorld::predictBall(dReal horizon,dReal sample_dt,QVector<PBallSample>& samples,QVector<PBallEvent>& events,
+                           const dReal* pos,const dReal* vel)
+{
+    // the substep of the last frame, so the ball model and the flight match the simulation
+    const dReal h = (last_dt > 0 && substeps > 0) ? last_dt/substeps : cfg->DeltaTime()/std::max(cfg->MinSubsteps(),1);
+    PBallPredictor predictor(ballModel(h),cfg->BallRadius(),cfg->Gravity(),cfg->BallBounce(),cfg->BallBounceVel());
+    predictor.setStep(h,dBodyGetLinearDamping(ball->body));
+    predictor.setField(cfg->Field_Length()/2,cfg->Field_Width()/2);
+    for (int i=0;i<WALL_COUNT;i++)
+        predictor.addObstacle(walls[i]->geom,-1);
+    for (int k=0;k<cfg->Robots_Count() * 2;k++)
+    {
+        if (!robots[k]->on) continue;
+        predictor.addObstacle(robots[k]->hull->geom,k);
+    }
+    const dReal still[3] = {0,0,0};
+    const dReal* angvel = still;
+    if (pos == nullptr || vel == nullptr)
+    {
+        pos = dBodyGetPosition(ball->body);
+        vel = dBodyGetLinearVel(ball->body);
+        angvel = dBodyGetAngularVel(ball->body);
+    }
+    predictor.predict(pos,vel,angvel,horizon,sample_dt,samples,events);
+}
+
 void SSLWorld::addRobotStatus(ZSS::New::Robots_Status& robotsPacket, int robotID, int team, bool infrared, KickStatus kickStatus)
 {
     auto* robot_status = robotsPacket.add_robots_status();
     robot_status->set_robot_id(robotID);
+    Robot* robot = robots[robotIndex(robotID, team)];
+    for (auto & wheel : robot->wheels)
+        robot_status->add_wheel_encoder(wheel->encoder);
 
     if (infrared)
         robot_status->set_infrared(1);
@@ -577,6 +909,116 @@ dReal limitRange(dReal t,dReal minimum,dReal maximum){
     return t;
 }
 
+void SSLWorld::publishGameEvents(const QVector<GameEvent>& events)
+{
+    if (events.isEmpty()) return;
+    grSim_GameEvents packet;
+    packet.set_frame(framenum);
+    for (const GameEvent& e : events)
+    {
+        emit gameEvent(e);
+        auto* event = packet.add_events();
+        event->set_type((grSim_GameEvent::Type)e.type);
+        event->set_t(e.t);
+        event->set_x(e.x);
+        event->set_y(e.y);
+        if (e.robot >= 0)
+        {
+            event->set_robot_id(e.robot % cfg->Robots_Count());
+            event->set_robot_yellow(e.robot >= cfg->Robots_Count());
+        }
+        event->set_goal_yellow(e.type == GameEvent::GOAL && e.goalYellow);
+        event->set_chip(e.kick == CHIP_KICK);
+        event->set_ball_speed(e.speed);
+    }
+    if (cfg->GameEventPort() <= 0) return;
+    std::string buffer;
+    packet.SerializeToString(&buffer);
+    eventSocket->writeDatagram(buffer.c_str(), buffer.length(), QHostAddress(QString(cfg->GameEventAddr().c_str())), cfg->GameEventPort());
+}
+
+void SSLWorld::placeBall(dReal x,dReal y,dReal vx,dReal vy)
+{
+    ball->setBodyPosition(x,y,cfg->BallRadius()*1.2);
+    dBodySetLinearVel(ball->body,vx,vy,0);
+    dBodySetAngularVel(ball->body,0,0,0);
+    dBodyEnable(ball->body);
+}
+
+void SSLWorld::checkHealth()
+{
+    const PWorldStats st = p->stats();
+    if (st.step_errors != stepErrors)
+    {
+        logStatus(QString("Physics step reported %1 problem(s) before %2 s: %3").arg(st.step_errors - stepErrors).arg(simTime).arg(p->lastStepError()),QColor("red"));
+        stepErrors = st.step_errors;
+    }
+    if (st.determinism_mismatches != determinismMismatches)
+    {
+        logStatus(QString("Threaded step differs from the serial one at %1 s (%2 of %3 checked steps)").arg(simTime)
+                  .arg(st.determinism_mismatches).arg(st.determinism_checks),QColor("red"));
+        determinismMismatches = st.determinism_mismatches;
+    }
+    static const char* faults[] = {"non finite state","left the world","too fast","energy jump","flipped"};
+    for (const WatchdogFault& f : watchdog->check(ball,robots))
+    {
+        QString what;
+        if (f.object < 0)
+        {
+            what = "ball";
+            for (int k=0;k<cfg->Robots_Count() * 2;k++)
+                if (robots[k]->kicker->holdingBall) robots[k]->kicker->unholdBall();
+            dMatrix3 R;
+            dRSetIdentity(R);
+            dBodySetRotation(ball->body,R);
+            placeBall(f.x,f.y,0,0);
+        }
+        else
+        {
+            what = QString("%1 robot %2").arg(f.object < cfg->Robots_Count() ? "blue" : "yellow").arg(f.object % cfg->Robots_Count());
+            Robot* robot = robots[f.object];
+            robot->kicker->unholdBall();
+            robot->setXY(f.x,f.y);
+            robot->resetRobot();
+        }
+        logStatus(QString("Watchdog at %1 s: %2 %3 (%4), reset at (%5, %6)").arg(simTime).arg(what).arg(faults[f.type])
+                  .arg(f.value).arg(f.x).arg(f.y),QColor("orange"));
+    }
+}
+
+void SSLWorld::stepReferee(const QVector<GameEvent>& events)
+{
+    // restarts are scheduled in simulated time, so the step loop never waits
+    for (const GameEvent& e : events)
+    {
+        if (refereeRestart >= 0) break;
+        if (e.type == GameEvent::GOAL)
+        {
+            refereeKickoff = true;
+            logStatus(QString("Auto referee: goal for %1").arg(e.goalYellow ? "yellow" : "blue"),QColor("green"));
+        }
+        else if (e.type == GameEvent::BALL_OUT)
+        {
+            // 0.2 m inside the line it left the field, in the corner for goal lines
+            const dReal lx = cfg->Field_Length()/2 - 0.2,ly = cfg->Field_Width()/2 - 0.2;
+            refereeKickoff = false;
+            refereeBall[0] = (fabs(e.x) > cfg->Field_Length()/2) ? copysign(lx,e.x) : qBound(-lx,e.x,lx);
+            refereeBall[1] = (fabs(e.x) > cfg->Field_Length()/2) ? copysign(ly,e.y) : qBound(-ly,e.y,ly);
+        }
+        else continue;
+        refereeRestart = simTime + cfg->AutoRefereeDelay();
+    }
+    if (refereeRestart < 0 || simTime < refereeRestart) return;
+    refereeRestart = -1;
+    if (refereeKickoff)
+    {
+        for (int team=0;team<TEAM_COUNT;team++)
+            forms[team]->resetRobots(robots,team);
+        placeBall(0,0,0,0);
+    }
+    else placeBall(refereeBall[0],refereeBall[1],0,0);
+}
+
 void SSLWorld::recvActions()
 {
     QHostAddress sender;
@@ -616,13 +1058,27 @@ void SSLWorld::recvActions()
                         vx = limitRange(vx,-lx,lx);
                         vy = limitRange(vy,-ly,ly);
                     }
-                    robots[id]->setSpeed(vx, vy, vw, cmd.cmd_vel().use_imu(), id);
+                    robots[id]->controller.stop();
+                    robots[id]->setSpeed(vx, vy, vw, cmd.cmd_vel().use_imu());
                 }else if(cmd.cmd_type() == ZSS::New::Robot_Command_CmdType_CMD_WHEEL){
                     auto ww = cmd.cmd_wheel();
+                    robots[id]->controller.stop();
                     robots[id]->setSpeed(0,ww.wheel1());
                     robots[id]->setSpeed(1,ww.wheel2());
                     robots[id]->setSpeed(2,ww.wheel3());
                     robots[id]->setSpeed(3,ww.wheel4());
+                }else if(cmd.cmd_type() == ZSS::New::Robot_Command_CmdType_CMD_POSE){
+                    // tracked onboard until the next command, start pose and twist are only the AI's estimate
+                    auto pose = cmd.cmd_pose();
+                    dReal target[3] = {pose.target().x(),pose.target().y(),pose.target().w()};
+                    dReal target_v[3] = {pose.target_v().x(),pose.target_v().y(),pose.target_v().w()};
+                    robots[id]->controller.setPose(target,target_v,pose.rotation_sense(),commandLimits(id,pose));
+                }else if(cmd.cmd_type() == ZSS::New::Robot_Command_CmdType_CMD_CHASE){
+                    auto chase = cmd.cmd_chase();
+                    dReal ball_p[2] = {chase.ball().x(),chase.ball().y()};
+                    dReal ball_v[2] = {chase.ball_v().x(),chase.ball_v().y()};
+                    dReal reach = robots[id]->kickerReach() + cfg->BallRadius();
+                    robots[id]->controller.setChase(ball_p,ball_v,simTime,reach,robots[id]->motionLimits());
                 }else{
                     std::cout << "grsim-sslworld.cpp : cmd type currently not supported" << std::endl;
                 }
@@ -664,6 +1120,13 @@ void SSLWorld::recvActions()
                 turnon = packet.replacement().robots(i).turnon();
                 int id = robotIndex(k, team);
                 if ((id < 0) || (id >= cfg->Robots_Count()*2)) continue;
+                if (robots[id]->getModel() == KINEMATIC_MODEL)
+                {
+                    // a stream of replacements is the pose trajectory of a kinematic robot
+                    robots[id]->addPoseSample(simTime,x,y,dir);
+                    robots[id]->on = turnon;
+                    continue;
+                }
                 robots[id]->setXY(x,y);
                 robots[id]->resetRobot();
                 robots[id]->setDir(dir);
@@ -682,9 +1145,7 @@ void SSLWorld::recvActions()
                 vx = packet.replacement().ball().vx();
                 vy = packet.replacement().ball().vy();
 
-                ball->setBodyPosition(x,y,cfg->BallRadius()*1.2);
-                dBodySetLinearVel(ball->body,vx,vy,0);
-                dBodySetAngularVel(ball->body,0,0,0);
+                placeBall(x,y,vx,vy);
             }
         }
 
@@ -710,6 +1171,66 @@ void SSLWorld::recvActions()
     }
 }
 
+void SSLWorld::recvPredictionRequests()
+{
+    QHostAddress sender;
+    quint16 port;
+    grSim_BallPredictionRequest request;
+    QVector<PBallSample> samples;
+    QVector<PBallEvent> events;
+    while (predictionSocket->hasPendingDatagrams())
+    {
+        int size = predictionSocket->readDatagram(in_buffer, 65536, &sender, &port);
+        if (size <= 0 || !request.ParseFromArray(in_buffer, size)) continue;
+        // keep the answer within one datagram
+        const dReal horizon = qBound(0.0, request.horizon(), 10.0);
+        const dReal sample_dt = std::max(request.sample_dt(), horizon/500);
+        if (request.has_ball())
+        {
+            const auto& b = request.ball();
+            const dReal pos[3] = {b.x(),b.y(),std::max(b.z(),(double)cfg->BallRadius())};
+            const dReal vel[3] = {b.vx(),b.vy(),b.vz()};
+            predictBall(horizon,sample_dt,samples,events,pos,vel);
+        }
+        else predictBall(horizon,sample_dt,samples,events);
+
+        grSim_BallPrediction prediction;
+        prediction.set_id(request.id());
+        prediction.set_sim_time(simTime);
+        for (const PBallSample& s : samples)
+        {
+            auto* sample = prediction.add_samples();
+            sample->set_t(s.t);
+            auto* b = sample->mutable_ball();
+            b->set_x(s.pos[0]);
+            b->set_y(s.pos[1]);
+            b->set_z(s.pos[2]);
+            b->set_vx(s.vel[0]);
+            b->set_vy(s.vel[1]);
+            b->set_vz(s.vel[2]);
+        }
+        for (const PBallEvent& e : events)
+        {
+            auto* event = prediction.add_events();
+            event->set_t(e.t);
+            event->set_x(e.pos[0]);
+            event->set_y(e.pos[1]);
+            if (e.type == PBallEvent::OUT) event->set_type(grSim_BallEvent::OUT);
+            else if (e.type == PBallEvent::STOP) event->set_type(grSim_BallEvent::STOP);
+            else if (e.tag < 0) event->set_type(grSim_BallEvent::WALL);
+            else
+            {
+                event->set_type(grSim_BallEvent::ROBOT);
+                event->set_robot_id(e.tag % cfg->Robots_Count());
+                event->set_yellowteam(e.tag >= cfg->Robots_Count());
+            }
+        }
+        std::string buffer;
+        prediction.SerializeToString(&buffer);
+        predictionSocket->writeDatagram(buffer.c_str(), buffer.length(), sender, port);
+    }
+}
+
 dReal normalizeAngle(dReal a)
 {
     if (a>180) return -360+a;
@@ -733,6 +1254,7 @@ bool SSLWorld::getCamPos(int id, double& cam_x, double& cam_y, double& cam_h){
     cam_x = cfg->Field_Length()/4*_CAM_CX[id];
     cam_y = cfg->Field_Width()/4*_CAM_CY[id];
     cam_h = cfg->camera_height();
+    return true;
 }
 bool SSLWorld::ballBlockedByRobot(int cam_id,double robot_x,double robot_y,double ball_x,double ball_y,double ball_z){
     cam_id %= _CAM_NUM;
@@ -758,133 +1280,111 @@ bool SSLWorld::ballBlockedByRobot(int cam_id,double robot_x,double robot_y,doubl
 }
 
 #define CONVUNIT(x) ((int)(1000*(x)))
-SSL_WrapperPacket* SSLWorld::generatePacket(int cam_id)
+void SSLWorld::generatePackets(const VisionSnapshot& snap,SSL_WrapperPacket** packets)
 {
-    SSL_WrapperPacket* packet = new SSL_WrapperPacket;
-    dReal x,y,z,dir,k;
-    ball->getBodyPosition(x,y,z);    
-    packet->mutable_detection()->set_camera_id(cam_id);
-    packet->mutable_detection()->set_frame_number(framenum);    
-    dReal t_elapsed = timer->elapsed()/1000.0;
-    packet->mutable_detection()->set_t_capture(t_elapsed);
-    packet->mutable_detection()->set_t_sent(t_elapsed);
+    // every object is looked at once and written to the cameras that see it
+    SSL_DetectionFrame* frames[_CAM_NUM];
+    const dReal t_elapsed = timer->elapsed()/1000.0;
+    for (int cam_id=0;cam_id<_CAM_NUM;cam_id++)
+    {
+        // cleared messages keep their submessages and strings for the next frame
+        packets[cam_id]->Clear();
+        frames[cam_id] = packets[cam_id]->mutable_detection();
+        frames[cam_id]->set_camera_id(cam_id);
+        frames[cam_id]->set_frame_number(snap.frame);
+        frames[cam_id]->set_t_capture(t_elapsed);
+        frames[cam_id]->set_t_sent(t_elapsed);
+    }
     dReal dev_x = cfg->noiseDeviation_x();
     dReal dev_y = cfg->noiseDeviation_y();
     dReal dev_a = cfg->noiseDeviation_angle();
-    if (sendGeomCount++ % cfg->sendGeometryEvery() == 0)
-    {
-        SSL_GeometryData* geom = packet->mutable_geometry();
-        SSL_GeometryFieldSize* field = geom->mutable_field();
-
-
-        // Old protocol
-//        field->set_line_width(CONVUNIT(cfg->Field_Line_Width()));
-//        field->set_referee_width(CONVUNIT(cfg->Field_Referee_Margin()));
-//        field->set_goal_wall_width(CONVUNIT(cfg->Goal_Thickness()));
-//        field->set_center_circle_radius(CONVUNIT(cfg->Field_Rad()));
-//        field->set_defense_radius(CONVUNIT(cfg->Field_Defense_Rad()));
-//        field->set_defense_stretch(CONVUNIT(cfg->Field_Defense_Stretch()));
-//        field->set_free_kick_from_defense_dist(CONVUNIT(cfg->Field_Free_Kick()));
-        //TODO: verify if these fields are correct:
-//        field->set_penalty_line_from_spot_dist(CONVUNIT(cfg->Field_Penalty_Line()));
-//        field->set_penalty_spot_from_field_line_dist(CONVUNIT(cfg->Field_Penalty_Point()));
-
-        // Current protocol (2015+)
-        // Field general info
-        field->set_field_length(CONVUNIT(cfg->Field_Length()));
-        field->set_field_width(CONVUNIT(cfg->Field_Width()));
-        field->set_boundary_width(CONVUNIT(cfg->Field_Margin()));
-        field->set_goal_width(CONVUNIT(cfg->Goal_Width()));
-        field->set_goal_depth(CONVUNIT(cfg->Goal_Depth()));
-
-        // Field lines and arcs
-        addFieldLinesArcs(field);
-
-    }
     if (cfg->noise()==false) {dev_x = 0;dev_y = 0;dev_a = 0;}
-    do{
-        if ((cfg->vanishing()==false) || (rand0_1() > cfg->ball_vanishing()))
-        {
-            if (visibleInCam(cam_id, x, y)) {
-                if(cfg->ball_blocked_by_robot()){
-                    bool blocked = false;
-                    dReal robot_x,robot_y;
-                    for(int i = 0; i < cfg->Robots_Count()*2; i++){
-                        robots[i]->getXY(robot_x,robot_y);
-                        bool res = ballBlockedByRobot(cam_id,robot_x,robot_y,x,y,z);
-                        if(res && rand0_1() <= cfg->ball_blocked_probability()){
-                            blocked = true;
-                            break;
-                        }
-                    }
-                    if(blocked) break;
-                }
-                double cam_x,cam_y,cam_z;
-                getCamPos(cam_id, cam_x, cam_y, cam_z);
-                SSL_DetectionBall* vball = packet->mutable_detection()->add_balls();
-                double x_p = x,y_p = y;
-                if(cfg->chip_ball_skewing()){
-                    x_p = (cam_z * x - z * cam_x) / (cam_z - z);
-                    y_p = (cam_z * y - z * cam_y) / (cam_z - z);
+    const dReal x = snap.ball[0],y = snap.ball[1],z = snap.ball[2];
+    for (int cam_id=0;cam_id<_CAM_NUM;cam_id++)
+    {
+        if (!visibleInCam(cam_id, x, y)) continue;
+        if ((cfg->vanishing()==true) && (rand0_1() <= cfg->ball_vanishing())) continue;
+        if(cfg->ball_blocked_by_robot()){
+            bool blocked = false;
+            for(int i = 0; i < cfg->Robots_Count()*2; i++){
+                bool res = ballBlockedByRobot(cam_id,snap.robots[i].x,snap.robots[i].y,x,y,z);
+                if(res && rand0_1() <= cfg->ball_blocked_probability()){
+                    blocked = true;
+                    break;
                 }
-                vball->set_x(randn_notrig(x_p*1000.0f,dev_x));
-                vball->set_y(randn_notrig(y_p*1000.0f,dev_y));
-                vball->set_z(z*1000.0f);
-                vball->set_pixel_x(x_p*1000.0f);
-                vball->set_pixel_y(y_p*1000.0f);
-                vball->set_confidence(0.9 + rand0_1()*0.1);
             }
+            if(blocked) continue;
         }
-    }while(false);
-    for(int i = 0; i < cfg->Robots_Count(); i++){
-        if ((cfg->vanishing()==false) || (rand0_1() > cfg->blue_team_vanishing()))
-        {
-            if (!robots[i]->on) continue;
-            robots[i]->getXY(x,y);
-            dir = robots[i]->getDir(k);
-            // reset when the robot has turned over
-            if (cfg->ResetTurnOver()) {
-                if (k < 0.9) {
-                    robots[i]->resetRobot();
-                }
-            }
-            if (visibleInCam(cam_id, x, y)) {
-                SSL_DetectionRobot* rob = packet->mutable_detection()->add_robots_blue();
-                rob->set_robot_id(i);
-                rob->set_pixel_x(x*1000.0f);
-                rob->set_pixel_y(y*1000.0f);
-                rob->set_confidence(1);
-                rob->set_x(randn_notrig(x*1000.0f,dev_x));
-                rob->set_y(randn_notrig(y*1000.0f,dev_y));
-                rob->set_orientation(normalizeAngle(randn_notrig(dir,dev_a))*M_PI/180.0f);
-            }
+        double cam_x,cam_y,cam_z;
+        getCamPos(cam_id, cam_x, cam_y, cam_z);
+        SSL_DetectionBall* vball = frames[cam_id]->add_balls();
+        double x_p = x,y_p = y;
+        if(cfg->chip_ball_skewing()){
+            x_p = (cam_z * x - z * cam_x) / (cam_z - z);
+            y_p = (cam_z * y - z * cam_y) / (cam_z - z);
         }
+        vball->set_x(randn_notrig(x_p*1000.0f,dev_x));
+        vball->set_y(randn_notrig(y_p*1000.0f,dev_y));
+        vball->set_z(z*1000.0f);
+        vball->set_pixel_x(x_p*1000.0f);
+        vball->set_pixel_y(y_p*1000.0f);
+        vball->set_confidence(0.9 + rand0_1()*0.1);
     }
-    for(int i = cfg->Robots_Count(); i < cfg->Robots_Count()*2; i++){
-        if ((cfg->vanishing()==false) || (rand0_1() > cfg->yellow_team_vanishing()))
+    for(int i = 0; i < cfg->Robots_Count()*2; i++){
+        const VisionSnapshot::RobotState& r = snap.robots[i];
+        if (!r.on) continue;
+        const bool yellow = i >= cfg->Robots_Count();
+        const dReal vanishing = yellow ? cfg->yellow_team_vanishing() : cfg->blue_team_vanishing();
+        for (int cam_id=0;cam_id<_CAM_NUM;cam_id++)
         {
-            if (!robots[i]->on) continue;
-            robots[i]->getXY(x,y);
-            dir = robots[i]->getDir(k);
-            // reset when the robot has turned over
-            if (cfg->ResetTurnOver()) {
-                if (k < 0.9) {
-                    robots[i]->resetRobot();
-                }
-            }
-            if (visibleInCam(cam_id, x, y)) {
-                SSL_DetectionRobot* rob = packet->mutable_detection()->add_robots_yellow();
-                rob->set_robot_id(i-cfg->Robots_Count());
-                rob->set_pixel_x(x*1000.0f);
-                rob->set_pixel_y(y*1000.0f);
-                rob->set_confidence(1);
-                rob->set_x(randn_notrig(x*1000.0f,dev_x));
-                rob->set_y(randn_notrig(y*1000.0f,dev_y));
-                rob->set_orientation(normalizeAngle(randn_notrig(dir,dev_a))*M_PI/180.0f);
-            }
+            if (!visibleInCam(cam_id, r.x, r.y)) continue;
+            if ((cfg->vanishing()==true) && (rand0_1() <= vanishing)) continue;
+            SSL_DetectionRobot* rob = yellow ? frames[cam_id]->add_robots_yellow() : frames[cam_id]->add_robots_blue();
+            rob->set_robot_id(yellow ? i-cfg->Robots_Count() : i);
+            rob->set_pixel_x(r.x*1000.0f);
+            rob->set_pixel_y(r.y*1000.0f);
+            rob->set_confidence(1);
+            rob->set_x(randn_notrig(r.x*1000.0f,dev_x));
+            rob->set_y(randn_notrig(r.y*1000.0f,dev_y));
+            rob->set_orientation(normalizeAngle(randn_notrig(r.dir,dev_a))*M_PI/180.0f);
         }
     }
-    return packet;
+}
+
+const QByteArray& SSLWorld::geometryDatagram()
+{
+    // the field only changes with a restart, which builds a new world
+    if (!geometryCache.isEmpty()) return geometryCache;
+    SSL_WrapperPacket packet;
+    SSL_GeometryData* geom = packet.mutable_geometry();
+    SSL_GeometryFieldSize* field = geom->mutable_field();
+
+    // Old protocol
+//    field->set_line_width(CONVUNIT(cfg->Field_Line_Width()));
+//    field->set_referee_width(CONVUNIT(cfg->Field_Referee_Margin()));
+//    field->set_goal_wall_width(CONVUNIT(cfg->Goal_Thickness()));
+//    field->set_center_circle_radius(CONVUNIT(cfg->Field_Rad()));
+//    field->set_defense_radius(CONVUNIT(cfg->Field_Defense_Rad()));
+//    field->set_defense_stretch(CONVUNIT(cfg->Field_Defense_Stretch()));
+//    field->set_free_kick_from_defense_dist(CONVUNIT(cfg->Field_Free_Kick()));
+    //TODO: verify if these fields are correct:
+//    field->set_penalty_line_from_spot_dist(CONVUNIT(cfg->Field_Penalty_Line()));
+//    field->set_penalty_spot_from_field_line_dist(CONVUNIT(cfg->Field_Penalty_Point()));
+
+    // Current protocol (2015+)
+    // Field general info
+    field->set_field_length(CONVUNIT(cfg->Field_Length()));
+    field->set_field_width(CONVUNIT(cfg->Field_Width()));
+    field->set_boundary_width(CONVUNIT(cfg->Field_Margin()));
+    field->set_goal_width(CONVUNIT(cfg->Goal_Width()));
+    field->set_goal_depth(CONVUNIT(cfg->Goal_Depth()));
+
+    // Field lines and arcs
+    addFieldLinesArcs(field);
+
+    geometryCache.resize(packet.ByteSize());
+    packet.SerializeToArray(geometryCache.data(), geometryCache.size());
+    return geometryCache;
 }
 
 void SSLWorld::addFieldLinesArcs(SSL_GeometryFieldSize *field) {
@@ -932,13 +1432,6 @@ void SSLWorld::addFieldLinesArcs(SSL_GeometryFieldSize *field) {
     addFieldArc(field, "CenterCircle",              0,     0,                  kCenterRadius-kLineThickness/2,  0,        2*M_PI,   kLineThickness);
 }
 
-Vector2f* SSLWorld::allocVector(float x, float y) {
-    Vector2f *vec = new Vector2f();
-    vec->set_x(x);
-    vec->set_y(y);
-    return vec;
-}
-
 void SSLWorld::addFieldLine(SSL_GeometryFieldSize *field, const std::string &name, float p1_x, float p1_y, float p2_x, float p2_y, float thickness) {
     SSL_FieldLineSegment *line = field->add_field_lines();
     line->set_name(name.c_str());
@@ -960,101 +1453,128 @@ void SSLWorld::addFieldArc(SSL_GeometryFieldSize *field, const std::string &name
     arc->set_thickness(thickness);
 }
 
-SendingPacket::SendingPacket(SSL_WrapperPacket* _packet,int _t)
+SendingPacket* SSLWorld::queueVisionPacket(int t)
 {
-    packet = _packet;
-    t      = _t;
+    if (sendCount == sendRing.size())
+    {
+        // only while warming up: line the queue up from the start and add free slots
+        std::rotate(sendRing.begin(),sendRing.begin() + sendHead,sendRing.end());
+        sendHead = 0;
+        const int n = std::max(2*_CAM_NUM,(int)sendRing.size());
+        for (int i=0;i<n;i++) sendRing.append(new SendingPacket);
+    }
+    SendingPacket* s = sendRing[(sendHead + sendCount) % sendRing.size()];
+    sendCount++;
+    s->t = t;
+    return s;
 }
 
 void SSLWorld::sendVisionBuffer()
 {
     int t = timer->elapsed();
-    sendQueue.push_back(new SendingPacket(generatePacket(0),t));    
-    sendQueue.push_back(new SendingPacket(generatePacket(1),t+1));
-    sendQueue.push_back(new SendingPacket(generatePacket(2),t+2));
-    sendQueue.push_back(new SendingPacket(generatePacket(3),t+3));
-    while (t - sendQueue.front()->t>=cfg->sendDelay())
+    const bool geometry = (sendGeomCount++ % cfg->sendGeometryEvery() == 0);
+    SSL_WrapperPacket* packets[_CAM_NUM];
+    for (int cam=0;cam<_CAM_NUM;cam++)
+    {
+        SendingPacket* s = queueVisionPacket(t+cam);
+        s->geometry = geometry && cam==0;
+        packets[cam] = &s->packet;
+    }
+    generatePackets(visionSnapshot,packets);
+    while (sendCount > 0 && t - sendRing[sendHead]->t>=cfg->sendDelay())
     {
-        SSL_WrapperPacket *packet = sendQueue.front()->packet;
-        delete sendQueue.front();
-        sendQueue.pop_front();
-        visionServer->send(*packet);
-        delete packet;
-        if (sendQueue.isEmpty()) break;
+        // a serialized wrapper holding only the geometry merges into the detection one
+        SendingPacket* s = sendRing[sendHead];
+        visionServer->send(s->packet,s->geometry ? geometryDatagram() : QByteArray());
+        sendHead = (sendHead + 1) % sendRing.size();
+        sendCount--;
     }
 }
 
-void RobotsFomation::setAll(dReal* xx,dReal *yy)
+void RobotsFomation::setAll(const dReal* xx,const dReal *yy,int n)
 {
-    for (int i=0;i<MAX_ROBOT_COUNT;i++)
+    x.resize(MAX_ROBOT_COUNT);
+    y.resize(MAX_ROBOT_COUNT);
+    for (int i=0;i<n;i++)
     {
         x[i] = xx[i];
         y[i] = yy[i];
     }
+    //robots beyond the table line up in rows behind the side wall, formations
+    //outlive a division change so the rows clear the walls of both divisions
+    const dReal wall_a = cfg->v_DivA_Field_Width->getDouble()/2 + cfg->v_DivA_Field_Margin->getDouble() + cfg->v_DivA_Wall_Thickness->getDouble();
+    const dReal wall_b = cfg->v_DivB_Field_Width->getDouble()/2 + cfg->v_DivB_Field_Margin->getDouble() + cfg->v_DivB_Wall_Thickness->getDouble();
+    for (int i=n;i<MAX_ROBOT_COUNT;i++)
+    {
+        int j = i - n;
+        x[i] = 0.40 + 0.40 * (j % 12);
+        y[i] = std::max(wall_a,wall_b) + 0.20 + 0.30 * (j / 12);
+    }
 }
 
 RobotsFomation::RobotsFomation(int type, ConfigWidget* _cfg):
 cfg(_cfg)
 {
+    setAll(nullptr,nullptr,0);
     if (type==0)
     {
-        dReal teamPosX[MAX_ROBOT_COUNT] = { 2.20,  1.00,  1.00,  1.00,  0.33,  1.22,
+        dReal teamPosX[FORMATION_TABLE_SIZE] = { 2.20,  1.00,  1.00,  1.00,  0.33,  1.22,
                                             3.00,  3.20,  3.40,  3.60,  3.80,  4.00,
                                             0.40,  0.80,  1.20,  1.60};
-        dReal teamPosY[MAX_ROBOT_COUNT] = { 0.00, -0.75,  0.00,  0.75,  0.25,  0.00,
+        dReal teamPosY[FORMATION_TABLE_SIZE] = { 0.00, -0.75,  0.00,  0.75,  0.25,  0.00,
                                             1.00,  1.00,  1.00,  1.00,  1.00,  1.00,
                                            -3.50, -3.50, -3.50, -3.50};
-        setAll(teamPosX,teamPosY);
+        setAll(teamPosX,teamPosY,FORMATION_TABLE_SIZE);
     }
     if (type==1) // formation 1
     {
-        dReal teamPosX[MAX_ROBOT_COUNT] = { 1.50,  1.50,  1.50,  0.55,  2.50,  3.60,
+        dReal teamPosX[FORMATION_TABLE_SIZE] = { 1.50,  1.50,  1.50,  0.55,  2.50,  3.60,
                                             3.20,  3.20,  3.20,  3.20,  3.20,  3.20,
                                             0.40,  0.80,  1.20,  1.60};
-        dReal teamPosY[MAX_ROBOT_COUNT] = { 1.12,  0.0,  -1.12,  0.00,  0.00,  0.00,
+        dReal teamPosY[FORMATION_TABLE_SIZE] = { 1.12,  0.0,  -1.12,  0.00,  0.00,  0.00,
                                             0.75, -0.75,  1.50, -1.50,  2.25, -2.25,
                                            -3.50, -3.50, -3.50, -3.50};
-        setAll(teamPosX,teamPosY);
+        setAll(teamPosX,teamPosY,FORMATION_TABLE_SIZE);
     }
     if (type==2) // formation 2
     {
-        dReal teamPosX[MAX_ROBOT_COUNT] = { 4.20,  3.40,  3.40,  0.70,  0.70,  0.70,
+        dReal teamPosX[FORMATION_TABLE_SIZE] = { 4.20,  3.40,  3.40,  0.70,  0.70,  0.70,
                                             2.00,  2.00,  2.00,  2.00,  2.00,  2.00,
                                             0.40,  0.80,  1.20,  1.60};
-        dReal teamPosY[MAX_ROBOT_COUNT] = { 0.00, -0.20,  0.20,  0.00,  2.25, -2.25,
+        dReal teamPosY[FORMATION_TABLE_SIZE] = { 0.00, -0.20,  0.20,  0.00,  2.25, -2.25,
                                             0.75, -0.75,  1.50, -1.50,  2.25, -2.25,
                                            -3.50, -3.50, -3.50, -3.50};
-        setAll(teamPosX,teamPosY);
+        setAll(teamPosX,teamPosY,FORMATION_TABLE_SIZE);
     }
     if (type==3) // outside field
     {
-        dReal teamPosX[MAX_ROBOT_COUNT] = { 0.40,  0.80,  1.20,  1.60,  2.00,  2.40,
+        dReal teamPosX[FORMATION_TABLE_SIZE] = { 0.40,  0.80,  1.20,  1.60,  2.00,  2.40,
                                             2.80,  3.20,  3.60,  4.00,  4.40,  4.80,
                                             0.40,  0.80,  1.20,  1.60};
-        dReal teamPosY[MAX_ROBOT_COUNT] = {-4.00, -4.00, -4.00, -4.00, -4.00, -4.00,
+        dReal teamPosY[FORMATION_TABLE_SIZE] = {-4.00, -4.00, -4.00, -4.00, -4.00, -4.00,
                                            -4.00, -4.00, -4.00, -4.00, -4.00, -4.00,
                                            -4.40, -4.40, -4.40, -4.40};
-        setAll(teamPosX,teamPosY);
+        setAll(teamPosX,teamPosY,FORMATION_TABLE_SIZE);
     }
     if (type==4)
     {
-        dReal teamPosX[MAX_ROBOT_COUNT] = { 2.80,  2.50,  2.50,  0.80,  0.80,  1.10,
+        dReal teamPosX[FORMATION_TABLE_SIZE] = { 2.80,  2.50,  2.50,  0.80,  0.80,  1.10,
                                             3.00,  3.20,  3.40,  3.60,  3.80,  4.00,
                                             0.40,  0.80,  1.20,  1.60};
-        dReal teamPosY[MAX_ROBOT_COUNT] = { 5.00,  4.70,  5.30,  5.00,  6.50,  5.50,
+        dReal teamPosY[FORMATION_TABLE_SIZE] = { 5.00,  4.70,  5.30,  5.00,  6.50,  5.50,
                                             1.00,  1.00,  1.00,  1.00,  1.00,  1.00,
                                            -3.50, -3.50, -3.50, -3.50};
-        setAll(teamPosX,teamPosY);
+        setAll(teamPosX,teamPosY,FORMATION_TABLE_SIZE);
     }
     if (type==-1) // outside
     {
-        dReal teamPosX[MAX_ROBOT_COUNT] = { 0.40,  0.80,  1.20,  1.60,  2.00,  2.40,
+        dReal teamPosX[FORMATION_TABLE_SIZE] = { 0.40,  0.80,  1.20,  1.60,  2.00,  2.40,
                                             2.80,  3.20,  3.60,  4.00,  4.40,  4.80,
                                             0.40,  0.80,  1.20,  1.60};
-        dReal teamPosY[MAX_ROBOT_COUNT] = {-3.40, -3.40, -3.40, -3.40, -3.40, -3.40,
+        dReal teamPosY[FORMATION_TABLE_SIZE] = {-3.40, -3.40, -3.40, -3.40, -3.40, -3.40,
                                            -3.40, -3.40, -3.40, -3.40, -3.40, -3.40,
                                            -3.20, -3.20, -3.20, -3.20};
-        setAll(teamPosX,teamPosY);
+        setAll(teamPosX,teamPosY,FORMATION_TABLE_SIZE);
     }
 
 }
@@ -1085,7 +1605,7 @@ void RobotsFomation::loadFromFile(const QString& filename)
     }
 }
 
-void RobotsFomation::resetRobots(Robot** r,int team)
+void RobotsFomation::resetRobots(const QVector<Robot*>& r,int team)
 {
     dReal dir=-1;
     if (team==1) dir = 1;
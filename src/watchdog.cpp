@@ -0,0 +1,167 @@
+/*
+grSim - RoboCup Small Size Soccer Robots Simulator
+Copyright (C) 2011, Parsian Robotic Center (eew.aut.ac.ir/~parsian/grsim)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "watchdog.h"
+#include <cmath>
+
+// a robot whose up axis leans more than about 25 degrees is turning over
+#define WATCHDOG_FLIPPED_UP 0.9
+// bodies this far from the field center have left the arena
+#define WATCHDOG_WORLD_SIZE 100.0
+
+static inline bool finite3(const dReal* v)
+{
+    return std::isfinite(v[0]) && std::isfinite(v[1]) && std::isfinite(v[2]);
+}
+
+static inline bool bodyFinite(dBodyID body)
+{
+    const dReal* q = dBodyGetQuaternion(body);
+    return finite3(dBodyGetPosition(body)) && finite3(dBodyGetLinearVel(body)) && finite3(dBodyGetAngularVel(body))
+        && finite3(q) && std::isfinite(q[3]);
+}
+
+static inline dReal sqr3(const dReal* v)
+{
+    return v[0]*v[0] + v[1]*v[1] + v[2]*v[2];
+}
+
+static inline dReal kineticEnergy(dBodyID body)
+{
+    dMass m;
+    dBodyGetMass(body,&m);
+    return 0.5*m.mass*sqr3(dBodyGetLinearVel(body));
+}
+
+WorldWatchdog::WorldWatchdog(ConfigWidget* _cfg,int robot_count)
+{
+    cfg = _cfg;
+    m_good_x.fill(0,robot_count);
+    m_good_y.fill(0,robot_count);
+    m_robot_energy.fill(0,robot_count);
+    m_ball_x = m_ball_y = 0;
+    m_ball_energy = 0;
+    m_recoveries = 0;
+}
+
+void WorldWatchdog::add(WatchdogFault::Type type,int object,dReal value)
+{
+    WatchdogFault f;
+    f.type = type;
+    f.object = object;
+    f.value = value;
+    f.x = (object < 0) ? m_ball_x : m_good_x[object];
+    f.y = (object < 0) ? m_ball_y : m_good_y[object];
+    m_faults.append(f);
+    m_recoveries++;
+}
+
+bool WorldWatchdog::checkRobot(int k,Robot* robot)
+{
+    dBodyID body = robot->chassis->body;
+    bool finite = bodyFinite(body) && bodyFinite(robot->kicker->box->body);
+    for (int i=0;i<4 && finite;i++)
+        finite = bodyFinite(robot->wheels[i]->cyl->body);
+    if (!finite)
+    {
+        add(WatchdogFault::NOT_FINITE,k,0);
+        return false;
+    }
+    const dReal* pos = dBodyGetPosition(body);
+    if (pos[2] < -1 || fabs(pos[0]) > WATCHDOG_WORLD_SIZE || fabs(pos[1]) > WATCHDOG_WORLD_SIZE)
+    {
+        add(WatchdogFault::LOST,k,pos[2]);
+        return false;
+    }
+    const dReal speed = sqrt(sqr3(dBodyGetLinearVel(body)));
+    const dReal angspeed = sqrt(sqr3(dBodyGetAngularVel(body)));
+    if (speed > cfg->WatchdogMaxSpeed() || angspeed > cfg->WatchdogMaxAngSpeed())
+    {
+        add(WatchdogFault::VELOCITY,k,std::max(speed,angspeed));
+        return false;
+    }
+    // z component of the local up axis, ODE matrices are row major with a stride of 4
+    const dReal up = dBodyGetRotation(body)[10];
+    if (cfg->ResetTurnOver() && up < WATCHDOG_FLIPPED_UP)
+    {
+        add(WatchdogFault::FLIPPED,k,up);
+        return false;
+    }
+    return true;
+}
+
+// a body can at most double its energy in a frame (kicks and collisions),
+// beyond that the solver is feeding energy into it
+bool WorldWatchdog::checkEnergy(int object,dReal energy,dReal& last)
+{
+    const dReal prev = last;
+    last = energy;
+    if (energy <= 2*prev + cfg->WatchdogEnergyJump()) return true;
+    add(WatchdogFault::ENERGY,object,energy - prev);
+    last = 0;
+    return false;
+}
+
+const QVector<WatchdogFault>& WorldWatchdog::check(PBall* ball,const QVector<Robot*>& robots)
+{
+    m_faults.clear();
+    for (int k=0;k<robots.size();k++)
+    {
+        Robot* robot = robots[k];
+        if (!robot->on || robot->getModel() == KINEMATIC_MODEL || !checkRobot(k,robot))
+        {
+            m_robot_energy[k] = 0;
+            continue;
+        }
+        checkEnergy(k,kineticEnergy(robot->chassis->body),m_robot_energy[k]);
+    }
+    bool ball_ok = bodyFinite(ball->body);
+    if (!ball_ok) add(WatchdogFault::NOT_FINITE,-1,0);
+    else
+    {
+        const dReal* pos = dBodyGetPosition(ball->body);
+        const dReal speed = sqrt(sqr3(dBodyGetLinearVel(ball->body)));
+        if (pos[2] < -1 || fabs(pos[0]) > WATCHDOG_WORLD_SIZE || fabs(pos[1]) > WATCHDOG_WORLD_SIZE)
+        {
+            add(WatchdogFault::LOST,-1,pos[2]);
+            ball_ok = false;
+        }
+        else if (speed > cfg->WatchdogMaxSpeed())
+        {
+            add(WatchdogFault::VELOCITY,-1,speed);
+            ball_ok = false;
+        }
+        else ball_ok = checkEnergy(-1,kineticEnergy(ball->body),m_ball_energy);
+    }
+    if (!ball_ok) m_ball_energy = 0;
+
+    for (int k=0;k<robots.size();k++)
+    {
+        if (!robots[k]->on || robots[k]->getModel() == KINEMATIC_MODEL) continue;
+        bool faulty = false;
+        for (const WatchdogFault& f : m_faults) faulty |= (f.object == k);
+        if (!faulty) robots[k]->getXY(m_good_x[k],m_good_y[k]);
+    }
+    if (ball_ok)
+    {
+        const dReal* pos = dBodyGetPosition(ball->body);
+        m_ball_x = pos[0];
+        m_ball_y = pos[1];
+    }
+    return m_faults;
+}